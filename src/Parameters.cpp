@@ -23,9 +23,12 @@ LICENSE
 
 */
 
+#ifndef Parameters_cpp
+#define Parameters_cpp
+
 #include "Parameters.hpp"
 
-Parameters::Parameters(const int p_argc, char const* const* const p_argv, config p_c):
+PARAMETERS_INLINE Parameters::Parameters(const int p_argc, char const* const* const p_argv, config p_c):
     argc(p_argc),
     argv(p_argv),
 
@@ -44,14 +47,21 @@ Parameters::Parameters(const int p_argc, char const* const* const p_argv, config
     choice_desc_indent(""),
 
     lang(p_c.lang),
-    description_is_set(false) {
+    description_is_set(false),
+    usage_is_set(false),
+    layout_jobs(1),
+    layout_params_per_job(512),
+    parent(nullptr),
+    compiled_size(0),
+    indexed_size(0),
+    current(nullptr) {
     for(int i=0 ; i<params_indent_len ; i++)      params_indent += " ";
     for(int i=0 ; i<desc_indent_len ; i++)        desc_indent += " ";
     for(int i=0 ; i<choice_indent_len ; i++)      choice_indent += " ";
     for(int i=0 ; i<choice_desc_indent_len ; i++) choice_desc_indent += " ";
 }
 
-Parameters::Parameters(const int p_argc, char const* const* const p_argv, config p_c, const int p_terminal_width):
+PARAMETERS_INLINE Parameters::Parameters(const int p_argc, char const* const* const p_argv, config p_c, const int p_terminal_width):
     argc(p_argc),
     argv(p_argv),
 
@@ -70,479 +80,2342 @@ Parameters::Parameters(const int p_argc, char const* const* const p_argv, config
     choice_desc_indent(""),
 
     lang(p_c.lang),
-    description_is_set(false) {
+    description_is_set(false),
+    usage_is_set(false),
+    layout_jobs(1),
+    layout_params_per_job(512),
+    parent(nullptr),
+    compiled_size(0),
+    indexed_size(0),
+    current(nullptr) {
     for(int i=0 ; i<params_indent_len ; i++)      params_indent += " ";
     for(int i=0 ; i<desc_indent_len ; i++)        desc_indent += " ";
     for(int i=0 ; i<choice_indent_len ; i++)      choice_indent += " ";
     for(int i=0 ; i<choice_desc_indent_len ; i++) choice_desc_indent += " ";
 }
 
-Parameters::~Parameters() {
-    for(std::pair<std::string, ParamHolder*> p: params) delete p.second;
+PARAMETERS_INLINE Parameters::Parameters(const int p_argc, char const* const* const p_argv, Parameters* const p_parent):
+    argc(p_argc),
+    argv(p_argv),
+
+    min_terminal_width(p_parent->min_terminal_width),
+    max_terminal_width(p_parent->max_terminal_width),
+    terminal_width(p_parent->terminal_width),
+    params_indent_len(p_parent->params_indent_len),
+    param_to_desc_len(p_parent->param_to_desc_len),
+    desc_indent_len(p_parent->desc_indent_len),
+    choice_indent_len(p_parent->choice_indent_len),
+    choice_desc_indent_len(p_parent->choice_desc_indent_len),
+    right_margin_len(p_parent->right_margin_len),
+    params_indent(p_parent->params_indent),
+    desc_indent(p_parent->desc_indent),
+    choice_indent(p_parent->choice_indent),
+    choice_desc_indent(p_parent->choice_desc_indent),
+
+    lang(p_parent->lang),
+    description_is_set(false),
+    usage_is_set(false),
+    layout_jobs(p_parent->layout_jobs),
+    layout_params_per_job(p_parent->layout_params_per_job),
+    parent(p_parent),
+    compiled_size(0),
+    indexed_size(0),
+    current(nullptr) {
+}
+
+PARAMETERS_INLINE Parameters::~Parameters() {
+    for(const std::pair<const std::string, ParamHolder*>& p: params) {
+        if(p.second->in_batch) p.second->~ParamHolder();
+        else                   delete p.second;
+    }
+    /* no reader can be left at this point */
+    delete current.load();
+    for(const std::pair<const Snapshot*, unsigned long long>& r: retired) delete r.first;
+}
+
+/*** errors and type checks ***/
+
+PARAMETERS_INLINE void Parameters::set_error_handler(const error_handler handler) {
+    current_error_handler() = handler;
+}
+
+PARAMETERS_INLINE Parameters::error_handler& Parameters::current_error_handler() {
+    static error_handler handler = nullptr;
+    return handler;
+}
+
+PARAMETERS_INLINE const Parameters::ERROR_CODE Parameters::last_error() {
+    return current_error().code;
+}
+
+PARAMETERS_INLINE const std::string Parameters::last_error_message() {
+    /* entry points only clear the code */
+    return current_error().code==error_none ? std::string() : current_error().message;
+}
+
+PARAMETERS_INLINE Parameters::error_state& Parameters::current_error() {
+    static thread_local error_state state = {error_none, std::string()};
+    return state;
+}
+
+PARAMETERS_INLINE void Parameters::record_error(const ERROR_CODE code, const std::exception& e) {
+    /* the functions the error goes back through return without doing anything else */
+    error_state& state = current_error();
+    state.code = code;
+    state.message.assign(e.what());
+}
+
+PARAMETERS_INLINE void Parameters::fail(const std::exception& e) {
+    /* the handler can exit, or jump back to the caller; if it returns, nothing can be undone */
+    if(current_error_handler()) current_error_handler()(e.what());
+    else                        std::cerr << e.what() << std::endl;
+    std::abort();
+}
+
+PARAMETERS_INLINE Parameters::ChoiceParam* const Parameters::choice_cast(ParamHolder* const p) {
+    return p->is_choice ? static_cast<ChoiceParam*>(p) : nullptr;
+}
+
+PARAMETERS_INLINE const Parameters::ChoiceParam* const Parameters::choice_cast(const ParamHolder* const p) {
+    return p->is_choice ? static_cast<const ChoiceParam*>(p) : nullptr;
 }
 
 /*** static functions ***/
 
-const int Parameters::get_terminal_width() {
+PARAMETERS_INLINE const int Parameters::get_terminal_width() {
     #if PLATFORM == PLATFORM_MAC || PLATFORM == PLATFORM_UNIX
-        /* linux, mac */
+        /* linux, mac, max width is used when not a terminal */
         struct winsize w;
-        ioctl(STDOUT_FILENO, TIOCGWINSZ, &w);
+        if(ioctl(STDOUT_FILENO, TIOCGWINSZ, &w)!=0 || w.ws_col==0) return std::numeric_limits<int>::max();
         return w.ws_col;
     #elif PLATFORM == PLATFORM_WINDOWS
         /* windows */
         CONSOLE_SCREEN_BUFFER_INFO csbi;
-        GetConsoleScreenBufferInfo(GetStdHandle(STD_OUTPUT_HANDLE), &csbi);
+        if(!GetConsoleScreenBufferInfo(GetStdHandle(STD_OUTPUT_HANDLE), &csbi)) return std::numeric_limits<int>::max();
         return csbi.srWindow.Right - csbi.srWindow.Left + 1;
     #endif
 }
 
-const std::string Parameters::bold(const std::string& str) {
+PARAMETERS_INLINE const bool Parameters::terminal_supports_styles() {
     #if PLATFORM == PLATFORM_MAC || PLATFORM == PLATFORM_UNIX
-        return "\e[1m" + str + "\e[0m";
+        /* a terminal, that is not dumb, and the user did not opt out */
+        if(!isatty(STDOUT_FILENO) || std::getenv("NO_COLOR")!=nullptr) return false;
+        const char* const term = std::getenv("TERM");
+        return term!=nullptr && term[0]!='\0' && std::strcmp(term, "dumb")!=0;
     #else
-        return str;
+        return false;
     #endif
 }
 
-const std::string Parameters::underline(const std::string& str) {
-    #if PLATFORM == PLATFORM_MAC || PLATFORM == PLATFORM_UNIX
-        return "\e[4m" + str + "\e[0m";
-    #else
-        return str;
-    #endif
+PARAMETERS_INLINE const std::string Parameters::bold(const std::string& str) {
+    return Renderer::bold_on + str + Renderer::bold_off;
+}
+
+PARAMETERS_INLINE const std::string Parameters::underline(const std::string& str) {
+    return Renderer::underline_on + str + Renderer::underline_off;
+}
+
+PARAMETERS_INLINE const Parameters::Span<char> Parameters::view(const std::string& str) {
+    return Span<char>(str.data(), str.size());
+}
+
+PARAMETERS_INLINE const int Parameters::visible_length(const std::string& str) {
+    int len = 0;
+    for(const char c: str) if(c<Renderer::bold_on || c>Renderer::underline_off) len++;
+    return len;
+}
+
+/*** renderers ***/
+
+PARAMETERS_INLINE Parameters::Renderer::Renderer(const sink& p_out):
+    out(p_out) {
+}
+
+PARAMETERS_INLINE Parameters::Renderer::Renderer(std::string& buffer):
+    out([&buffer] (const char* const data, const std::size_t size) { buffer.append(data, size); }) {
+}
+
+PARAMETERS_INLINE Parameters::Renderer::Renderer(std::ostream& stream):
+    out([&stream] (const char* const data, const std::size_t size) { stream.write(data, static_cast<std::streamsize>(size)); }) {
+}
+
+PARAMETERS_INLINE void Parameters::Renderer::begin() {
+    const char* const text = header();
+    out(text, std::strlen(text));
+}
+
+PARAMETERS_INLINE void Parameters::Renderer::write(const std::string& text) {
+    /* markers are replaced by styles, other chars may be escaped */
+    std::string styled;
+    styled.reserve(text.size());
+    for(const char c: text) {
+        if(c>=bold_on && c<=underline_off) { styled += style(c); continue; }
+        const char* const escaped = escape(c);
+        if(escaped!=nullptr) styled += escaped;
+        else                 styled += c;
+    }
+    PARAMETERS_TRACE_SCOPE("flush_output", styled.size());
+    out(styled.data(), styled.size());
+}
+
+PARAMETERS_INLINE void Parameters::Renderer::end() {
+    const char* const text = footer();
+    out(text, std::strlen(text));
+}
+
+PARAMETERS_INLINE const char* Parameters::AnsiRenderer::style(const char marker) const {
+    if(marker==bold_on)      return "\e[1m";
+    if(marker==underline_on) return "\e[4m";
+    return "\e[0m";
+}
+
+PARAMETERS_INLINE const char* Parameters::HtmlRenderer::style(const char marker) const {
+    if(marker==bold_on)      return "<b>";
+    if(marker==bold_off)     return "</b>";
+    if(marker==underline_on) return "<u>";
+    return "</u>";
+}
+
+PARAMETERS_INLINE const char* Parameters::HtmlRenderer::escape(const char c) const {
+    if(c=='&') return "&amp;";
+    if(c=='<') return "&lt;";
+    if(c=='>') return "&gt;";
+    return nullptr;
 }
 
 /*** setters ***/
 
-void Parameters::set_program_description(const std::string &p_description) {
-    description        = p_description + " ";
+PARAMETERS_INLINE void Parameters::set_program_description(const std::string &p_description) {
+    description        = p_description;
     description_is_set = true;
 }
 
-void Parameters::set_usage(const std::string &p_usage) {
+PARAMETERS_INLINE void Parameters::set_usage(const std::string &p_usage) {
     usage        = p_usage;
     usage_is_set = true;
 }
 
+PARAMETERS_INLINE void Parameters::set_layout_jobs(const std::size_t jobs, const std::size_t params_per_job) {
+    layout_jobs           = jobs;
+    layout_params_per_job = params_per_job!=0 ? params_per_job : 1;
+}
+
 /*** build help menu ***/
 
-void Parameters::insert_subsection(const std::string& subsection_title) {
+PARAMETERS_INLINE void Parameters::insert_subsection(const std::string& subsection_title) {
     subsections.push_back(subsection_title);
     subs_indexes.push_back(params.size());
 }
 
-void Parameters::define_param(const std::string& param_name, const std::string& param_desc) {
+PARAMETERS_INLINE const std::uint32_t Parameters::StringPool::intern(std::string&& str) {
+    const std::size_t hash = std::hash<std::string>()(str);
+    typedef std::unordered_multimap<std::size_t, std::uint32_t>::const_iterator ids_iterator;
+    const std::pair<ids_iterator, ids_iterator> same_hash = ids.equal_range(hash);
+    for(ids_iterator it=same_hash.first ; it!=same_hash.second ; ++it) {
+        if(strings[it->second]==str) return it->second;
+    }
+    strings.push_back(std::move(str));
+    const std::uint32_t id = static_cast<std::uint32_t>(strings.size()-1);
+    ids.insert(std::make_pair(hash, id));
+    return id;
+}
+
+PARAMETERS_INLINE const Parameters::Span<char> Parameters::keep(Text&& text) {
+    if(text.literal!=nullptr) return Span<char>(text.literal, text.literal_size);
+    return view(pool.at(pool.intern(std::move(text.owned))));
+}
+
+PARAMETERS_INLINE std::vector<std::uint32_t> Parameters::intern_all(const std::vector<std::string>& strs) {
+    std::vector<std::uint32_t> ids;
+    ids.reserve(strs.size());
+    for(const std::string& str: strs) ids.push_back(pool.intern(std::string(str)));
+    return ids;
+}
+
+PARAMETERS_INLINE void Parameters::define_param(const std::string& param_name, Text param_desc) {
+    add_param<Param<bool>>(param_name, keep(std::move(param_desc)));
+}
+
+PARAMETERS_INLINE void Parameters::define_choice_param(const std::string& param_name, const std::string& value_name, const std::string& default_choice, vec_choices p_choices, Text param_desc, const bool display_default_value) {
     /* check if already exist */
     if(params.count("--" + param_name)) {
-        throw DuplicateParameterException(param_name, "Parameters::define_param", lang);
+        PARAMETERS_THROW(DuplicateParameterException(param_name, "Parameters::define_param", lang));
+    }
+    /* find default choice */
+    std::size_t default_index = p_choices.size();
+    for(std::size_t i=0 ; i<p_choices.size() ; i++) {
+        if(p_choices[i].first==default_choice) default_index = i;
     }
-    /* get type name */
-    const std::string type_name = typeid(bool).name();
-    /* create param */
-    Param<bool>* const p = new Param<bool>("--" + param_name, param_desc);
-    /* store param */
-    order.insert(std::make_pair(params.size(), "--" + param_name));
-    params.insert(std::make_pair("--" + param_name, p));
+    if(default_index==p_choices.size()) {
+        PARAMETERS_THROW(UnknownChoiceException("--" + param_name, default_choice, "Parameters::define_choice_param", lang));
+    }
+    /* create param, choices are moved into it */
+    add_param<ChoiceParam>(param_name, keep(std::move(param_desc)), intern_all({value_name}), default_index, std::move(p_choices), display_default_value);
+}
+
+PARAMETERS_INLINE void Parameters::define_choice_param(const std::string& param_name, const std::string& value_name, const std::string& default_choice, vec_choices p_choices, Text param_desc, std::string& dest, const bool display_default_value) {
+    define_choice_param(param_name, value_name, default_choice, std::move(p_choices), std::move(param_desc), display_default_value);
+    choice_cast(params.at("--" + param_name))->bind(dest);
+}
+
+PARAMETERS_INLINE void Parameters::define_param(const std::string& param_name, Text param_desc, bool& dest) {
+    define_param(param_name, std::move(param_desc));
+    ParamHolder* const p = params.at("--" + param_name);
+    p->bound_spec = &dest;
+    dest          = false;
 }
 
-void Parameters::define_choice_param(const std::string& param_name, const std::string& value_name, const std::string& default_choice, vec_choices p_choices, const std::string& param_desc, const bool display_default_value) {
+PARAMETERS_INLINE void Parameters::define_subcommand(const std::string& subcommand_name, const std::string& subcommand_desc, subcommand_factory factory) {
     /* check if already exist */
-    if(params.count("--" + param_name)) {
-        throw DuplicateParameterException(param_name, "Parameters::define_param", lang);
+    if(subcommands.count(subcommand_name)) {
+        PARAMETERS_THROW(DuplicateParameterException(subcommand_name, "Parameters::define_subcommand", lang));
+    }
+    /* store subcommand, its parameters will only be defined if it is invoked */
+    subcommands.insert(std::make_pair(subcommand_name, std::make_pair(subcommand_desc, factory)));
+    subcommands_order.push_back(subcommand_name);
+}
+
+/*** bulk definitions ***/
+
+PARAMETERS_INLINE const std::size_t Parameters::count_items(const char* list) {
+    if(list==nullptr) return 0;
+    std::size_t n = 1;
+    for( ; *list ; list++) if(*list=='|') n++;
+    return n;
+}
+
+PARAMETERS_INLINE const bool Parameters::has_control(const char* first, const char* const last) {
+    for( ; first!=last ; first++) if((*first>=0 && *first<' ') || *first==127) return true;
+    return false;
+}
+
+PARAMETERS_INLINE const std::uint64_t Parameters::prefix_word(const char* str) {
+    std::uint64_t word = 0;
+    for(int b=0 ; b<8 ; b++) {
+        word = word<<8 | static_cast<unsigned char>(*str);
+        if(*str) str++;
+    }
+    return word;
+}
+
+PARAMETERS_INLINE void Parameters::unescape(char* str) {
+    char* w = str;
+    for(const char* r=str ; *r ; r++) {
+        if(*r=='\\' && (r[1]=='n' || r[1]=='t' || r[1]=='\\')) {
+            r++;
+            *w++ = *r=='n' ? '\n' : *r=='t' ? '\t' : '\\';
+        }
+        else *w++ = *r;
+    }
+    *w = '\0';
+}
+
+PARAMETERS_INLINE std::vector<std::uint32_t> Parameters::intern_items(const char* list) {
+    std::vector<std::uint32_t> ids;
+    ids.reserve(count_items(list));
+    while(list) {
+        const char* last = list;
+        while(*last && *last!='|') last++;
+        ids.push_back(pool.intern(std::string(list, last)));
+        list = *last ? last + 1 : nullptr;
+    }
+    return ids;
+}
+
+PARAMETERS_INLINE const Parameters::value_kind* Parameters::find_value_kind(const char* const type) {
+    static const value_kind kinds[] = {
+        {ParseTraits<short int>::name(),              sizeof(Param<short int>),              &build_value<short int>},
+        {ParseTraits<unsigned short int>::name(),     sizeof(Param<unsigned short int>),     &build_value<unsigned short int>},
+        {ParseTraits<int>::name(),                    sizeof(Param<int>),                    &build_value<int>},
+        {ParseTraits<unsigned int>::name(),           sizeof(Param<unsigned int>),           &build_value<unsigned int>},
+        {ParseTraits<long int>::name(),               sizeof(Param<long int>),               &build_value<long int>},
+        {ParseTraits<unsigned long int>::name(),      sizeof(Param<unsigned long int>),      &build_value<unsigned long int>},
+        {ParseTraits<long long int>::name(),          sizeof(Param<long long int>),          &build_value<long long int>},
+        {ParseTraits<unsigned long long int>::name(), sizeof(Param<unsigned long long int>), &build_value<unsigned long long int>},
+        {ParseTraits<float>::name(),                  sizeof(Param<float>),                  &build_value<float>},
+        {ParseTraits<double>::name(),                 sizeof(Param<double>),                 &build_value<double>},
+        {ParseTraits<long double>::name(),            sizeof(Param<long double>),            &build_value<long double>},
+        {ParseTraits<std::string>::name(),            sizeof(Param<std::string>),            &build_value<std::string>},
+        {ParseTraits<bool>::name(),                   sizeof(Param<bool>),                   &build_value<bool>}
+    };
+    for(const value_kind& kind: kinds) {
+        if(std::strcmp(kind.type, type)==0) return &kind;
+    }
+    return nullptr;
+}
+
+PARAMETERS_INLINE void Parameters::define_schema(const descriptor* const entries, const std::size_t nb_entries) {
+    PARAMETERS_TRACE_SCOPE("define_schema", nb_entries);
+    current_error().code = error_none;
+    /* check the entries and place them in the batch, nothing is stored yet */
+    std::vector<const value_kind*> kinds(nb_entries, nullptr);
+    std::vector<std::size_t>       places(nb_entries, 0);
+    std::vector<sort_key>          sorted;
+    std::size_t                    batch_size = 0;
+    const std::size_t              batch_unit = sizeof(std::max_align_t);
+    sorted.reserve(nb_entries);
+    for(std::size_t i=0 ; i<nb_entries ; i++) {
+        const descriptor& d = entries[i];
+        if(d.name==nullptr) PARAMETERS_FAIL(error_invalid_descriptor, InvalidDescriptorException(i, "Parameters::define_schema", lang));
+        /* names are printed as they are in the help menu, so they cannot have control chars */
+        if(has_control(d.name, d.name + std::strlen(d.name)) || (d.values_names && has_control(d.values_names, d.values_names + std::strlen(d.values_names)))) {
+            PARAMETERS_FAIL(error_invalid_descriptor, InvalidDescriptorException(i, "Parameters::define_schema", lang));
+        }
+        std::size_t size = 0;
+        if(d.kind==descriptor_subsection) {
+            continue;
+        }
+        else if(d.kind==descriptor_param) {
+            size = sizeof(Param<bool>);
+        }
+        else if(d.kind==descriptor_value) {
+            kinds[i] = find_value_kind(d.type ? d.type : "");
+            if(kinds[i]==nullptr) PARAMETERS_FAIL(error_unsupported_type, UnsupportedParameterTypeException(d.type ? d.type : "", "Parameters::define_schema", lang));
+            const std::size_t nb_values = count_items(d.values_names);
+            if(nb_values==0) PARAMETERS_FAIL(error_invalid_descriptor, InvalidDescriptorException(i, "Parameters::define_schema", lang));
+            if(d.defaults && count_items(d.defaults)!=nb_values) {
+                PARAMETERS_FAIL(error_not_enough_values, NotEnoughValuesException(std::string("--") + d.name, static_cast<int>(nb_values), static_cast<int>(count_items(d.defaults)), "Parameters::define_schema", lang));
+            }
+            size = kinds[i]->size;
+        }
+        else if(d.kind==descriptor_choice) {
+            if(count_items(d.values_names)!=1 || count_items(d.defaults)!=1 || d.choices==nullptr) {
+                PARAMETERS_FAIL(error_invalid_descriptor, InvalidDescriptorException(i, "Parameters::define_schema", lang));
+            }
+            size = sizeof(ChoiceParam);
+        }
+        else {
+            PARAMETERS_FAIL(error_invalid_descriptor, InvalidDescriptorException(i, "Parameters::define_schema", lang));
+        }
+        if(*d.name=='\0') PARAMETERS_FAIL(error_invalid_descriptor, InvalidDescriptorException(i, "Parameters::define_schema", lang));
+        places[i]   = batch_size;
+        batch_size += (size + batch_unit - 1) / batch_unit;
+        sorted.push_back(sort_key{0, d.name, i});
+    }
+    /* generated names share long prefixes: they are sorted by the 8 chars that follow the common prefix */
+    std::size_t common = sorted.empty() ? 0 : std::strlen(sorted[0].name);
+    for(const sort_key& s: sorted) {
+        std::size_t n = 0;
+        while(n<common && s.name[n]==sorted[0].name[n]) n++;
+        common = n;
+    }
+    for(sort_key& s: sorted) s.word = prefix_word(s.name + common);
+    std::sort(sorted.begin(), sorted.end(), [common](const sort_key& a, const sort_key& b) {
+        if(a.word!=b.word) return a.word<b.word;
+        return (a.word & 0xff)!=0 && std::strcmp(a.name + common + 8, b.name + common + 8)<0;
+    });
+    /* then duplicates are neighbours, and one walk along params finds those already defined */
+    std::vector<std::string>          keys(sorted.size());
+    std::vector<map_params::iterator> hints(sorted.size());
+    map_params::iterator              it = params.begin();
+    for(std::size_t k=0 ; k<sorted.size() ; k++) {
+        const char* const name = sorted[k].name;
+        if(k>0 && std::strcmp(name, sorted[k-1].name)==0) {
+            PARAMETERS_FAIL(error_duplicate_parameter, DuplicateParameterException(name, "Parameters::define_schema", lang));
+        }
+        keys[k].reserve(std::strlen(name) + 2);
+        keys[k].append("--").append(name);
+        while(it!=params.end() && it->first<keys[k]) ++it;
+        if(it!=params.end() && it->first==keys[k]) {
+            PARAMETERS_FAIL(error_duplicate_parameter, DuplicateParameterException(name, "Parameters::define_schema", lang));
+        }
+        hints[k] = it;
+    }
+    /* keys are inserted in order, each right before its hint */
+    std::unique_ptr<std::max_align_t[]> batch(new std::max_align_t[batch_size]);
+    std::vector<map_params::iterator>   slots(nb_entries, params.end());
+    for(std::size_t k=0 ; k<sorted.size() ; k++) {
+        slots[sorted[k].entry] = params.insert(hints[k], map_params::value_type(std::move(keys[k]), nullptr));
+    }
+    const std::size_t first_id  = order.size();
+    const std::size_t first_sub = subsections.size();
+    order.reserve(first_id + sorted.size());
+    /* lambda function to build the params in definition order, it returns at the first error */
+    auto build = [&] () {
+        for(std::size_t i=0 ; i<nb_entries ; i++) {
+            const descriptor& d = entries[i];
+            if(d.kind==descriptor_subsection) {
+                subsections.push_back(d.name);
+                subs_indexes.push_back(order.size());
+                continue;
+            }
+            void* const        place = batch.get() + places[i];
+            const std::string& name  = slots[i]->first;
+            const Span<char>   desc  = d.description ? Span<char>(d.description, std::strlen(d.description)) : Span<char>();
+            ParamHolder*       p     = nullptr;
+            if(d.kind==descriptor_param) {
+                p = new(place) Param<bool>(name, desc);
+            }
+            else if(d.kind==descriptor_value) {
+                p = kinds[i]->build(place, name, desc, intern_items(d.values_names), d.defaults, d.display_default_value, lang);
+                if(PARAMETERS_FAILED) return;
+            }
+            else {
+                vec_choices choices;
+                choices.reserve(count_items(d.choices));
+                std::size_t default_index = count_items(d.choices);
+                for(const char* first=d.choices ; first ; ) {
+                    const char* last = first;
+                    while(*last && *last!='|') last++;
+                    const char* const sep = static_cast<const char*>(std::memchr(first, '=', static_cast<std::size_t>(last-first)));
+                    if(sep==nullptr || has_control(first, sep)) PARAMETERS_FAIL(error_invalid_descriptor, InvalidDescriptorException(i, "Parameters::define_schema", lang));
+                    if(std::strncmp(first, d.defaults, static_cast<std::size_t>(sep-first))==0 && d.defaults[sep-first]=='\0') {
+                        default_index = choices.size();
+                    }
+                    choices.push_back(std::make_pair(std::string(first, sep), std::string(sep+1, last)));
+                    first = *last ? last + 1 : nullptr;
+                }
+                if(default_index==choices.size()) PARAMETERS_FAIL(error_unknown_choice, UnknownChoiceException(name, d.defaults, "Parameters::define_schema", lang));
+                p = new(place) ChoiceParam(name, desc, intern_items(d.values_names), default_index, std::move(choices), d.display_default_value);
+            }
+            p->in_batch     = true;
+            slots[i]->second = p;
+            p->id           = order.size();
+            order.push_back(p);
+        }
+    };
+    /* lambda function to undo everything if one of them fails */
+    auto undo = [&] () {
+        for(std::size_t id=first_id ; id<order.size() ; id++) order[id]->~ParamHolder();
+        order.resize(first_id);
+        subsections.resize(first_sub);
+        subs_indexes.resize(first_sub);
+        for(std::size_t i=0 ; i<nb_entries ; i++) {
+            if(slots[i]!=params.end()) params.erase(slots[i]);
+        }
+    };
+    PARAMETERS_TRY {
+        build();
+    }
+    PARAMETERS_CATCH_ALL {
+        undo();
+        PARAMETERS_RETHROW;
+    }
+    if(PARAMETERS_FAILED) {
+        undo();
+        return;
+    }
+    batches.push_back(std::move(batch));
+}
+
+PARAMETERS_INLINE void Parameters::load_schema(const std::string& path) {
+    PARAMETERS_TRACE_SCOPE("load_schema", -1);
+    current_error().code = error_none;
+    /* the file is kept, the entries point into it */
+    schemas.push_back(std::string());
+    std::string& text = schemas.back();
+    #if PLATFORM == PLATFORM_MAC || PLATFORM == PLATFORM_UNIX
+        const int fd = open(path.c_str(), O_RDONLY);
+        struct stat st;
+        if(fd<0 || fstat(fd, &st)!=0) {
+            if(fd>=0) close(fd);
+            schemas.pop_back();
+            PARAMETERS_FAIL(error_unreadable_schema, UnreadableSchemaException(path, "Parameters::load_schema", lang));
+        }
+        const std::size_t size = static_cast<std::size_t>(st.st_size);
+        void* const       data = size ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : nullptr;
+        close(fd);
+        if(data==MAP_FAILED) {
+            schemas.pop_back();
+            PARAMETERS_FAIL(error_unreadable_schema, UnreadableSchemaException(path, "Parameters::load_schema", lang));
+        }
+        if(size) {
+            text.assign(static_cast<const char*>(data), size);
+            munmap(data, size);
+        }
+    #else
+        std::ifstream in(path, std::ios::binary);
+        if(!in) {
+            schemas.pop_back();
+            PARAMETERS_FAIL(error_unreadable_schema, UnreadableSchemaException(path, "Parameters::load_schema", lang));
+        }
+        text.assign((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    #endif
+    if(text.empty() || text.back()!='\n') text += '\n';
+    /* lambda to find the end of the line starting at pos and its LF, a CR before the LF is left out */
+    char* const end = &text[0] + text.size();
+    auto read_line = [end] (char* const pos, char*& stop) {
+        stop = static_cast<char*>(std::memchr(pos, '\n', static_cast<std::size_t>(end-pos)));
+        return stop>pos && stop[-1]=='\r' ? stop - 1 : stop;
+    };
+    char*       c        = &text[0];
+    char*       stop     = nullptr;
+    char*       line_end = read_line(c, stop);
+    std::size_t line     = 1;
+    static const char schema_header[] = "help80-schema 1";
+    if(static_cast<std::size_t>(line_end-c)!=sizeof(schema_header)-1 || std::memcmp(c, schema_header, sizeof(schema_header)-1)!=0) {
+        schemas.pop_back();
+        PARAMETERS_FAIL(error_invalid_schema, InvalidSchemaException(path, 1, "Parameters::load_schema", lang));
+    }
+    /* split each line in place: fields end with a NUL instead of a tab, escapes are replaced */
+    std::vector<descriptor> entries;
+    for(c=stop+1 ; c<end ; c=stop+1) {
+        line++;
+        line_end = read_line(c, stop);
+        if(c==line_end || *c=='#') continue;
+        char*       fields[7] = {c};
+        std::size_t nb_fields = 1;
+        *line_end = '\0';
+        for(char* tab=c ; (tab=static_cast<char*>(std::memchr(tab, '\t', static_cast<std::size_t>(line_end-tab))))!=nullptr ; ) {
+            *tab++ = '\0';
+            if(nb_fields<7) fields[nb_fields] = tab;
+            nb_fields++;
+        }
+        /* empty fields are null, like missing ones in a descriptor */
+        const bool escaped = std::memchr(c, '\\', static_cast<std::size_t>(line_end-c))!=nullptr;
+        for(std::size_t k=1 ; k<nb_fields && k<7 ; k++) {
+            if(*fields[k]=='\0') fields[k] = nullptr;
+            else if(escaped)      unescape(fields[k]);
+        }
+        descriptor d = {descriptor_param, fields[1], nullptr, nullptr, nullptr, nullptr, false, nullptr};
+        if(std::strcmp(fields[0], "subsection")==0 && nb_fields==2) {
+            d.kind = descriptor_subsection;
+            if(d.name==nullptr) d.name = "";
+        }
+        else if(std::strcmp(fields[0], "param")==0 && nb_fields==3) {
+            d.description = fields[2];
+        }
+        else if(std::strcmp(fields[0], "value")==0 && nb_fields==7) {
+            d.kind                  = descriptor_value;
+            d.type                  = fields[2];
+            d.values_names          = fields[3];
+            d.defaults              = fields[4];
+            d.display_default_value = fields[5] && std::strcmp(fields[5], "1")==0;
+            d.description           = fields[6];
+        }
+        else if(std::strcmp(fields[0], "choice")==0 && nb_fields==7) {
+            d.kind                  = descriptor_choice;
+            d.values_names          = fields[2];
+            d.defaults              = fields[3];
+            d.choices               = fields[4];
+            d.display_default_value = fields[5] && std::strcmp(fields[5], "1")==0;
+            d.description           = fields[6];
+        }
+        else {
+            schemas.pop_back();
+            PARAMETERS_FAIL(error_invalid_schema, InvalidSchemaException(path, line, "Parameters::load_schema", lang));
+        }
+        if(d.name==nullptr) {
+            schemas.pop_back();
+            PARAMETERS_FAIL(error_invalid_schema, InvalidSchemaException(path, line, "Parameters::load_schema", lang));
+        }
+        entries.push_back(d);
+    }
+    PARAMETERS_TRY {
+        define_schema(entries.data(), entries.size());
     }
-    /* get type name */
-    const std::string type_name = typeid(std::string).name();
-    /* append space in descriptions */
-    for(std::pair<std::string, std::string>& p:p_choices) p.second += " ";
-    /* create param */
-    Param<std::string>* const p = new Param<std::string>("--" + param_name, param_desc, {value_name}, {default_choice}, display_default_value);
-    /* store param */
-    order.insert(std::make_pair(params.size(), "--" + param_name));
-    params.insert(std::make_pair("--" + param_name, p));
-    choices.insert(std::make_pair("--" + param_name, p_choices));
-    choices_params.insert("--" + param_name);
+    PARAMETERS_CATCH_ALL {
+        schemas.pop_back();
+        PARAMETERS_RETHROW;
+    }
+    if(PARAMETERS_FAILED) schemas.pop_back();
 }
 
 /*** display help menu ***/
 
-void Parameters::print_text(const std::string& text, const bool start_on_new_line, const int indent_len, const std::string& indent, ParamHolder* const p) const {
+PARAMETERS_INLINE void Parameters::print_text(const Span<char>& text, const bool start_on_new_line, const int indent_len, const std::string& indent, ParamHolder* const p, Renderer& r, const bool styled) const {
+    PARAMETERS_TRACE_SCOPE("layout_paragraph", text.size());
     std::string line       = "";
     std::string word       = "";
+    int         line_len   = 0;                                             // visible chars in line
+    int         word_len   = 0;                                             // visible chars in word
     bool        first_line = true;
     bool        first_word = true;
-    int         word_pad   = 0;     // used when replacing $_x by value name
-    bool        in_par_val = false;
-    /* lambda function to replace $_x by value name */
-    auto replace_by_value_name = [&word, &p, &in_par_val] () {
-        std::string value_num_str = word.substr(2);
-        int         value_num     = stoi(value_num_str);
-        if(value_num>0) {
-            if(word.size()>3) word = "<" + underline(p->values_names.at(static_cast<std::size_t>(value_num-1))) + ">" + word.substr(3);
-            else              word = "<" + underline(p->values_names.at(static_cast<std::size_t>(value_num-1))) + ">";
-            #if PLATFORM == PLATFORM_MAC || PLATFORM == PLATFORM_UNIX
-                in_par_val = true;
-            #endif
+    const int   width      = std::max(1, terminal_width-right_margin_len-indent_len); // room for text on a line
+    /* lambda function to print a line, indented unless it starts where the caller left off */
+    auto print_line = [&first_line, &start_on_new_line, &indent, &r] (const std::string& str) {
+        if(!first_line || start_on_new_line) r.write(indent);
+        first_line = false;
+        r.write(str + "\n");
+    };
+    /* lambda function to replace $_x by value name and $p(name) by a param name, other words are left as they are */
+    auto decorate = [this, &word, &p] () {
+        if(word.compare(0, 2, "$_")==0 && p) {
+            std::size_t digits    = 2;
+            std::size_t value_num = 0;
+            while(digits<word.size() && digits<8 && std::isdigit(static_cast<unsigned char>(word[digits]))) value_num = value_num*10 + static_cast<std::size_t>(word[digits++]-'0');
+            if(digits==2) return;
+            if(value_num==0)                          word = "\"" + bold(p->name) + "\"" + word.substr(digits);
+            else if(value_num<=p->values_names.size()) word = "<" + underline(pool.at(p->values_names[value_num-1])) + ">" + word.substr(digits);
         }
-        else {
-            if(word.size()>3) word = "\"" + bold(p->name) + "\"" + word.substr(3);
-            else              word = "\"" + bold(p->name) + "\"";
+        else if(word.compare(0, 3, "$p(")==0) {
+            const std::size_t end_ind = word.find(')', 3);
+            if(end_ind==std::string::npos) return;
+            if(end_ind+1<word.size()) word = "\"--" + bold(word.substr(3, end_ind-3)) + "\"" + bold(word.substr(end_ind+1));
+            else                      word = "\"--" + bold(word.substr(3, end_ind-3)) + "\"";
         }
     };
-    /* for each character in the text */
-    for(std::size_t j=0 ; j<text.length() ; j++) {
-        char c = text.at(j);
-        if(c!=' ' && c!= '\n' && indent_len+static_cast<int>(word.length())<terminal_width-right_margin_len) {
-            /* we are in a middle of a word and we still have space so far */
+    /* for each character in the text, the end of the text ends the last word like a space */
+    for(std::size_t j=0 ; j<=text.size() ; j++) {
+        char c = j<text.size() ? text[j] : ' ';
+        /* tabs separate words, other control chars would be taken for styles or escape codes, unless the text is styled by the library */
+        const bool marker = styled && c>=Renderer::bold_on && c<=Renderer::underline_off;
+        if(c=='\t')                                             c = ' ';
+        else if(((c>=0 && c<' ' && c!='\n') || c==127) && !marker) continue;
+        if(c!=' ' && c!= '\n') {
+            /* we are in a middle of a word */
             word += c;
+            if(!marker) word_len++;
+            continue;
+        }
+        if(word.size()>1 && word[0]=='$' && !styled) {
+            decorate();
+            word_len = visible_length(word);
+        }
+        /* display word */
+        if(line_len+word_len+1<=width) {
+            /* if this word plus the previous space can fit, print it */
+            if(first_word) { line = word; line_len = word_len; first_word = false; }
+            else           { line += ' '; line += word; line_len += word_len + 1; }
+        }
+        else if(word_len<width) {
+            /* the word can fit on a line in its entirety, so print the current line and take a new line */
+            print_line(line);
+            line     = word;
+            line_len = word_len;
         }
         else {
-            /* text decoration */
-            if(word.find("$_")==0) {
-                replace_by_value_name();
-                #if PLATFORM == PLATFORM_MAC || PLATFORM == PLATFORM_UNIX
-                    word_pad = 8;
-                #endif
+            /* the word cannot fit on a line in its entirety, so fill the current line and go on with whole lines */
+            std::string start = "";
+            int         room  = width;
+            if(line!="") {
+                if(line_len+1<width) { start = line + " "; room = width - line_len - 1; }
+                else                 { print_line(line); }
             }
-            else if(word.find("$p(")==0) {
-                std::size_t end_ind = word.find(")");
-                if(word.at(word.length()-1)!=')') word = "\"--" + bold(word.substr(3, end_ind-3)) + "\"" + bold(word.substr(end_ind+1));
-                else                              word = "\"--" + bold(word.substr(3, end_ind-3)) + "\"";
-                #if PLATFORM == PLATFORM_MAC || PLATFORM == PLATFORM_UNIX
-                    word_pad = 8;
-                #endif
-            }
-            /* display word */
-            if(indent_len+static_cast<int>(line.length()+word.length())-word_pad+1<=terminal_width-right_margin_len) {
-                /* if this word plus the previous space can fit, print it */
-                if(c!='\n') {
-                    if(first_word) { line = word; first_word = false; }
-                    else           { line += " " + word; }
-                    word = "";
-                }
-                /* if a new line is requested, take a new line */
-                else {
-                    if(first_word) { line = word; first_word = false; }
-                    else           { line += " " + word; }
-                    if(!first_line || start_on_new_line) std::cout << indent;
-                    if(first_line)                       first_line = false;
-                    std::cout << line << std::endl;
-                    first_word = true;
-                    line       = "";
-                    word       = "";
-                }
-            }
-            else {
-                /* line would be too long, we need to go on next line */
-                if(!first_line || start_on_new_line) std::cout << indent;
-                if(first_line)                       first_line = false;
-                if(indent_len+static_cast<int>(word.length())-word_pad<terminal_width-right_margin_len) {
-                    /* the next word can fit on a line in its entirety, so print the current line and take a new line */
-                    std::cout << line << std::endl;
-                    line = word;
-                    word = "";
-                }
-                else {
-                    /* the next word cannot fit on a line in its entirety, so fill the current line and take a new line */
-                    /* the word will be split. Careful if first word is too long */
-                    int line_len;
-                    if(line!="") { std::cout << line << " "; line_len = static_cast<int>(line.length() + 1); }
-                    else         { line_len = 0; }
-                    int ind = terminal_width-(right_margin_len+indent_len+line_len);
-                    if(ind<0) ind=0;
-                    std::cout << word.substr(0, static_cast<std::size_t>(word_pad/2 + ind));
-                    /* disable underline */
-                    if(in_par_val) std::cout << "\e[0m";
-                    std::cout << std::endl;
-                    if(in_par_val) { word = "\e[4m" + word.substr(static_cast<std::size_t>(word_pad/2 + ind)); word_pad = 4; }
-                    else           { word = word.substr(static_cast<std::size_t>(word_pad/2 + ind)); }
-                    word.push_back(c);
-                    line       = "";
-                    first_word = true;
+            /* cut after room visible chars, a style left open is closed and opened again on next line */
+            std::size_t pos  = 0;
+            char        open = 0;
+            int         left = word_len;
+            while(left>room) {
+                std::string piece = open!=0 ? std::string(1, open) : std::string();
+                const std::size_t from = pos;
+                for(int n=0 ; pos<word.size() && n<room ; pos++) {
+                    if(word[pos]==Renderer::bold_on || word[pos]==Renderer::underline_on)        open = word[pos];
+                    else if(word[pos]==Renderer::bold_off || word[pos]==Renderer::underline_off) open = 0;
+                    else                                                                         n++;
                 }
+                while(pos<word.size() && (word[pos]==Renderer::bold_off || word[pos]==Renderer::underline_off)) { open = 0; pos++; }
+                piece.append(word, from, pos-from);
+                if(open!=0) piece += static_cast<char>(open+1);
+                print_line(start + piece);
+                start.clear();
+                left -= room;
+                room  = width;
             }
-            if(word_pad==8) word_pad   = 0;
-            in_par_val = false;
+            /* the end of the word starts the next line */
+            line       = (open!=0 ? std::string(1, open) : std::string()) + word.substr(pos);
+            line_len   = left;
+            first_word = false;
+        }
+        word.clear();
+        word_len = 0;
+        /* if a new line is requested, take a new line */
+        if(c=='\n') {
+            print_line(line);
+            line       = "";
+            line_len   = 0;
+            first_word = true;
         }
     }
     /* print last line */
-    if(!first_line || start_on_new_line) std::cout << indent;
-    std::cout << line << std::endl;
+    if(!first_line || start_on_new_line) r.write(indent);
+    r.write(line + "\n");
+}
+
+PARAMETERS_INLINE void Parameters::print_help(const bool p_print_usage, const bool p_print_description) const {
+    if(terminal_supports_styles()) { AnsiRenderer  r(std::cout); print_help(r, p_print_usage, p_print_description); }
+    else                           { PlainRenderer r(std::cout); print_help(r, p_print_usage, p_print_description); }
+    std::cout << std::flush;
 }
 
-void Parameters::print_help(const bool p_print_usage, const bool p_print_description) const {
-    if(description_is_set && p_print_description) { print_description(); }
-    if(usage_is_set       && p_print_usage)       { print_usage(); }
-    print_parameters();
+PARAMETERS_INLINE void Parameters::print_help(Renderer& r, const bool p_print_usage, const bool p_print_description) const {
+    PARAMETERS_TRACE_SCOPE("print_help", params.size());
+    r.begin();
+    if(description_is_set && p_print_description) { print_description(r); }
+    if(usage_is_set       && p_print_usage)       { print_usage(r); }
+    print_parameters(r);
+    if(!subcommands.empty()) print_subcommands(r);
+    r.end();
 }
 
-void Parameters::print_description() const {
-    std::cout << std::endl;
-    if(lang==lang_fr) std::cout << bold("DESCRIPTION :") << std::endl;
-    else              std::cout << bold("DESCRIPTION:") << std::endl;
+PARAMETERS_INLINE void Parameters::print_description(Renderer& r) const {
+    r.write("\n");
+    if(lang==lang_fr) r.write(bold("DESCRIPTION :") + "\n");
+    else              r.write(bold("DESCRIPTION:") + "\n");
     /* print description */
-    print_text(description, true, params_indent_len, params_indent, nullptr);
+    print_text(view(description), true, params_indent_len, params_indent, nullptr, r);
+}
+
+PARAMETERS_INLINE void Parameters::print_usage(Renderer& r) const {
+    r.write("\n");
+    if(lang==lang_fr) r.write(bold("UTILISATION :") + "\n");
+    else              r.write(bold("USAGE:") + "\n");
+    r.write(params_indent + usage + "\n");
 }
 
-void Parameters::print_usage() const {
-    std::cout << std::endl;
-    if(lang==lang_fr) std::cout << bold("UTILISATION :") << std::endl;
-    else              std::cout << bold("USAGE:") << std::endl;
-    std::cout << params_indent << usage << std::endl;
+/* keeps the markers, so that the text can go through the caller's renderer later */
+class Parameters::LayoutRenderer: public Parameters::Renderer {
+    public:
+        using Parameters::Renderer::Renderer;
+    protected:
+        const char* style(const char marker) const {
+            static const char markers[4][2] = {{bold_on, 0}, {bold_off, 0}, {underline_on, 0}, {underline_off, 0}};
+            return markers[marker-bold_on];
+        }
+};
+
+PARAMETERS_INLINE void Parameters::print_parameters(Renderer& r) const {
+    r.write("\n");
+    /* threads are only started when asked for, with fewer params per thread the calling thread prints the menu */
+    std::size_t nb_jobs = layout_jobs!=0 ? layout_jobs : std::thread::hardware_concurrency();
+    if(nb_jobs>params.size()/layout_params_per_job) nb_jobs = params.size()/layout_params_per_job;
+    if(nb_jobs<=1) {
+        print_parameters(r, 0, params.size());
+        return;
+    }
+    /* each thread lays out a range of params in its own buffer, buffers are written in order */
+    std::vector<std::string>        buffers(nb_jobs);
+    std::vector<std::exception_ptr> errors(nb_jobs);
+    std::vector<error_state>        failed(nb_jobs);
+    std::vector<std::thread>        threads;
+    for(std::size_t j=0 ; j<nb_jobs ; j++) {
+        threads.emplace_back([this, j, nb_jobs, &buffers, &errors, &failed] () {
+            current_error().code = error_none;
+            PARAMETERS_TRY {
+                LayoutRenderer layout(buffers[j]);
+                print_parameters(layout, params.size()*j/nb_jobs, params.size()*(j+1)/nb_jobs);
+            }
+            PARAMETERS_CATCH_ALL {
+                errors[j] = std::current_exception();
+            }
+            /* without exceptions, an error is kept in the error of the thread */
+            failed[j] = current_error();
+        });
+    }
+    for(std::thread& t: threads) t.join();
+    for(std::size_t j=0 ; j<nb_jobs ; j++) {
+        if(errors[j]) std::rethrow_exception(errors[j]);
+        if(failed[j].code!=error_none) { current_error() = failed[j]; return; }
+    }
+    for(std::size_t j=0 ; j<nb_jobs ; j++) r.write(buffers[j]);
 }
 
-void Parameters::print_parameters() const {
-    std::cout << std::endl;
-    for(std::size_t i=0 ; i<params.size() ; i++) {
+PARAMETERS_INLINE void Parameters::print_parameters(Renderer& r, const std::size_t first, const std::size_t last) const {
+    PARAMETERS_TRACE_SCOPE("layout_params", last-first);
+    /* subsections are sorted by index, the next one to print is found once */
+    std::size_t j = static_cast<std::size_t>(std::lower_bound(subs_indexes.begin(), subs_indexes.end(), first) - subs_indexes.begin());
+    for(std::size_t i=first ; i<last ; i++) {
     
         /* print subsection if needed */
-        for(std::size_t j=0 ; j<subs_indexes.size() ; j++) {
-            if(subs_indexes[j]==i) {
-                if(lang==lang_fr) std::cout << bold(subsections[j] + " :") << std::endl;
-                else              std::cout << bold(subsections[j] + ":") << std::endl;
-            }
-        }
-        
-        /* retrieve param */
-        ParamHolder* p = params.at(order.at(i));
-        /* build use string */
-        std::string use = params_indent + bold(p->name);
-        for(std::string value_name: p->values_names) use += " <" + underline(value_name) + ">";
-        
-        /* print param and values to take */
-        bool desc_on_new_line = false;
-        int  len_adjust       = 0;
-        #if PLATFORM == PLATFORM_MAC || PLATFORM == PLATFORM_UNIX
-            len_adjust = 8 + p->nb_values*8;
-        #endif
-        if(static_cast<int>(use.length())-len_adjust+param_to_desc_len>desc_indent_len) {
-            /* print param list now if too long */
-            std::cout << use << std::endl;
-            desc_on_new_line = true;
-        }
-        else {
-            /* print list and spaces if it fits */
-            /* minus one because one space will be added by first description line */
-            std::string spaces = "";
-            for(int j=0 ; j<desc_indent_len-static_cast<int>(use.length())+len_adjust ; j++) spaces += " ";
-            std::cout << use << spaces;
+        for( ; j<subs_indexes.size() && subs_indexes[j]==i ; j++) {
+            if(lang==lang_fr) r.write(bold(subsections[j] + " :") + "\n");
+            else              r.write(bold(subsections[j] + ":") + "\n");
         }
         
-        /* print description */
-        print_text(p->description, desc_on_new_line, desc_indent_len, desc_indent, p);
-        
-        /* print choices */
-        if(choices_params.count(p->name)) {
-            for(const std::pair<std::string, std::string>& pc: choices.at(p->name)) {
-                /* print choice and new line */
-                if(lang==lang_fr) std::cout << desc_indent << choice_indent << "\"" << bold(pc.first) << "\" :" << std::endl;
-                else              std::cout << desc_indent << choice_indent << "\"" << bold(pc.first) << "\":" << std::endl;
-                /* print choice description */
-                const std::string indent = desc_indent + choice_indent + choice_desc_indent;
-                print_text(pc.second, true, static_cast<int>(indent.size()), indent, p);
+        print_param(order[i], r, std::vector<std::size_t>());
+    }
+}
+
+PARAMETERS_INLINE void Parameters::print_param(ParamHolder* const p, Renderer& r, const std::vector<std::size_t>& shown_choices) const {
+    /* build use string */
+    std::string use = params_indent;
+    if(p->positional) use += positional_use(p);
+    else {
+        use += bold(p->name);
+        for(const std::uint32_t value_name: p->values_names) use += " <" + underline(pool.at(value_name)) + ">";
+    }
+    
+    /* print param and values to take */
+    bool desc_on_new_line = false;
+    const int use_len     = visible_length(use);
+    if(use_len+param_to_desc_len>desc_indent_len) {
+        /* print param list now if too long */
+        r.write(use + "\n");
+        desc_on_new_line = true;
+    }
+    else {
+        /* print list and spaces if it fits */
+        /* minus one because one space will be added by first description line */
+        std::string spaces = "";
+        for(int j=0 ; j<desc_indent_len-use_len ; j++) spaces += " ";
+        r.write(use + spaces);
+    }
+    
+    /* print description */
+    print_text(p->description, desc_on_new_line, desc_indent_len, desc_indent, p, r);
+    
+    /* print choices */
+    const ChoiceParam* const p_choice = choice_cast(p);
+    if(p_choice!=0) {
+        for(std::size_t k=0 ; k<p_choice->choices.size() ; k++) {
+            if(!shown_choices.empty() && !std::binary_search(shown_choices.begin(), shown_choices.end(), k)) continue;
+            const std::pair<std::string, std::string>& pc = p_choice->choices[k];
+            /* print choice and new line, without the choice indent if it does not fit */
+            const std::string choice = "\"" + bold(pc.first) + (lang==lang_fr ? "\" :" : "\":");
+            if(desc_indent_len+choice_indent_len+visible_length(choice)<=terminal_width-right_margin_len) {
+                const std::string indent = desc_indent + choice_indent;
+                print_text(view(choice), true, static_cast<int>(indent.size()), indent, nullptr, r, true);
             }
+            else print_text(view(choice), true, desc_indent_len, desc_indent, nullptr, r, true);
+            /* print choice description */
+            const std::string indent = desc_indent + choice_indent + choice_desc_indent;
+            print_text(view(pc.second), true, static_cast<int>(indent.size()), indent, p, r);
         }
-        
-        /* print default value */
-        if(p->display_default_value) {
-            if(p->type_name==typeid(short int).name())                   pr_def<short int>(p);
-            else if(p->type_name==typeid(unsigned short int).name())     pr_def<unsigned short int>(p);
-            else if(p->type_name==typeid(int).name())                    pr_def<int>(p);
-            else if(p->type_name==typeid(unsigned int).name())           pr_def<unsigned int>(p);
-            else if(p->type_name==typeid(long int).name())               pr_def<long int>(p);
-            else if(p->type_name==typeid(unsigned long int).name())      pr_def<unsigned long int>(p);
-            else if(p->type_name==typeid(long long int).name())          pr_def<long long int>(p);
-            else if(p->type_name==typeid(unsigned long long int).name()) pr_def<unsigned long long int>(p);
-            else if(p->type_name==typeid(float).name())                  pr_def<float>(p);
-            else if(p->type_name==typeid(double).name())                 pr_def<double>(p);
-            else if(p->type_name==typeid(long double).name())            pr_def<long double>(p);
-            else if(p->type_name==typeid(std::string).name())            pr_def<std::string>(p, true);
-        }
-        
-        /* skip line */
-        std::cout << std::endl;
     }
+    
+    /* print default value */
+    if(p->display_default_value) pr_def(p, r);
+    
+    /* print constraints */
+    print_constraints(p, r);
+    
+    /* skip line */
+    r.write("\n");
 }
 
-/*** use parameters ***/
+PARAMETERS_INLINE void Parameters::pr_def(ParamHolder* const p, Renderer& r) const {
+    /* no param, so that a default value is printed as it is */
+    print_rule(lang==lang_fr ? "Défaut :" : "Default:", p->default_text(), nullptr, r);
+}
 
-void Parameters::parse_params() {
-    for(int i=1 ; i<argc ; i++) {
-        /* get arg name */
-        const std::string line_param(argv[i]);
-        if(params.count(line_param)) {
-            /* retrieve param */
-            ParamHolder* const p = params[line_param];
-            /* read param values */
-            for(std::size_t j=0 ; j<static_cast<std::size_t>(p->nb_values) ; j++) {
-                if(++i<argc) {
-                    std::string arg_value(argv[i]);
-                    if(p->type_name==typeid(short int).name()) {
-                        Param<short int>* const p_reint = dynamic_cast<Param<short int>* const>(p);
-                        if(p_reint==0) throw DynamicCastFailedException(line_param, "Parameters::parse_params", lang);
-                        int                     tmp_val = 0;
-                        try { tmp_val = std::stoi(arg_value); }
-                        catch(const std::invalid_argument& e) { throw IntegerExpectedException(line_param, arg_value, "Parameters::parse_params", lang); }
-                        catch(const std::out_of_range& e)     { throw ValueOutOfRangeException<short int>(line_param, arg_value, "Parameters::parse_params", lang); }
-                        /* arg_value is a valid unsigned long int, but is it a valid unsigned int */
-                        short int min = std::numeric_limits<short int>::min();
-                        short int max = std::numeric_limits<short int>::max();
-                        if(tmp_val<static_cast<int>(min) || tmp_val>static_cast<int>(max)) { throw ValueOutOfRangeException<short int>(line_param, arg_value, "Parameters::parse_params", lang); }
-                        else { p_reint->values[j] = static_cast<short int>(tmp_val); }
-                    }
-                    else if(p->type_name==typeid(unsigned short int).name()) {
-                        Param<unsigned short int>* const p_reint = dynamic_cast<Param<unsigned short int>* const>(p);
-                        if(p_reint==0) throw DynamicCastFailedException(line_param, "Parameters::parse_params", lang);
-                        unsigned long int                tmp_val = 0;
-                        try { tmp_val = std::stoul(arg_value); }
-                        catch(const std::invalid_argument& e) { throw IntegerExpectedException(line_param, arg_value, "Parameters::parse_params", lang); }
-                        catch(const std::out_of_range& e)     { throw ValueOutOfRangeException<unsigned short int>(line_param, arg_value, "Parameters::parse_params", lang); }
-                        /* arg_value is a valid unsigned long int, but is it a valid unsigned int */
-                        unsigned short int min = std::numeric_limits<unsigned short int>::min();
-                        unsigned short int max = std::numeric_limits<unsigned short int>::max();
-                        if(tmp_val<static_cast<unsigned long int>(min) || tmp_val>static_cast<unsigned long int>(max)) { throw ValueOutOfRangeException<unsigned short int>(line_param, arg_value, "Parameters::parse_params", lang); }
-                        else { p_reint->values[j] = static_cast<unsigned short int>(tmp_val); }
-                    }
-                    else if(p->type_name==typeid(int).name()) {
-                        Param<int>* const p_reint = dynamic_cast<Param<int>* const>(p);
-                        if(p_reint==0) throw DynamicCastFailedException(line_param, "Parameters::parse_params", lang);
-                        try { p_reint->values[j] = std::stoi(arg_value); }
-                        catch(const std::invalid_argument& e) { throw IntegerExpectedException(line_param, arg_value, "Parameters::parse_params", lang); }
-                        catch(const std::out_of_range& e)     { throw ValueOutOfRangeException<int>(line_param, arg_value, "Parameters::parse_params", lang); }
-                    }
-                    else if(p->type_name==typeid(unsigned int).name()) {
-                        Param<unsigned int>* const p_reint = dynamic_cast<Param<unsigned int>* const>(p);
-                        if(p_reint==0) throw DynamicCastFailedException(line_param, "Parameters::parse_params", lang);
-                        unsigned long int          tmp_val = 0;
-                        try { tmp_val = std::stoul(arg_value); }
-                        catch(const std::invalid_argument& e) { throw IntegerExpectedException(line_param, arg_value, "Parameters::parse_params", lang); }
-                        catch(const std::out_of_range& e)     { throw ValueOutOfRangeException<unsigned int>(line_param, arg_value, "Parameters::parse_params", lang); }
-                        /* arg_value is a valid unsigned long int, but is it a valid unsigned int */
-                        unsigned int min = std::numeric_limits<unsigned int>::min();
-                        unsigned int max = std::numeric_limits<unsigned int>::max();
-                        if(tmp_val<static_cast<unsigned long int>(min) || tmp_val>static_cast<unsigned long int>(max)) { throw ValueOutOfRangeException<unsigned int>(line_param, arg_value, "Parameters::parse_params", lang); }
-                        else { p_reint->values[j] = static_cast<unsigned int>(tmp_val); }
-                    }
-                    else if(p->type_name==typeid(long int).name()) {
-                        Param<long int>* const p_reint = dynamic_cast<Param<long int>* const>(p);
-                        if(p_reint==0) throw DynamicCastFailedException(line_param, "Parameters::parse_params", lang);
-                        try { p_reint->values[j] = std::stol(arg_value); }
-                        catch(const std::invalid_argument& e) { throw IntegerExpectedException(line_param, arg_value, "Parameters::parse_params", lang); }
-                        catch(const std::out_of_range& e)     { throw ValueOutOfRangeException<long int>(line_param, arg_value, "Parameters::parse_params", lang); }
-                    }
-                    else if(p->type_name==typeid(unsigned long int).name()) {
-                        Param<unsigned long int>* const p_reint = dynamic_cast<Param<unsigned long int>* const>(p);
-                        if(p_reint==0) throw DynamicCastFailedException(line_param, "Parameters::parse_params", lang);
-                        try { p_reint->values[j] = std::stoul(arg_value); }
-                        catch(const std::invalid_argument& e) { throw IntegerExpectedException(line_param, arg_value, "Parameters::parse_params", lang); }
-                        catch(const std::out_of_range& e)     { throw ValueOutOfRangeException<unsigned long int>(line_param, arg_value, "Parameters::parse_params", lang); }
-                    }
-                    else if(p->type_name==typeid(long long int).name()) {
-                        Param<long long int>* const p_reint = dynamic_cast<Param<long long int>* const>(p);
-                        if(p_reint==0) throw DynamicCastFailedException(line_param, "Parameters::parse_params", lang);
-                        try { p_reint->values[j] = std::stoll(arg_value); }
-                        catch(const std::invalid_argument& e) { throw IntegerExpectedException(line_param, arg_value, "Parameters::parse_params", lang); }
-                        catch(const std::out_of_range& e)     { throw ValueOutOfRangeException<long long int>(line_param, arg_value, "Parameters::parse_params", lang); }
-                    }
-                    else if(p->type_name==typeid(unsigned long long int).name()) {
-                        Param<unsigned long long int>* const p_reint = dynamic_cast<Param<unsigned long long int>* const>(p);
-                        if(p_reint==0) throw DynamicCastFailedException(line_param, "Parameters::parse_params", lang);
-                        try { p_reint->values[j] = std::stoull(arg_value); }
-                        catch(const std::invalid_argument& e) { throw IntegerExpectedException(line_param, arg_value, "Parameters::parse_params", lang); }
-                        catch(const std::out_of_range& e)     { throw ValueOutOfRangeException<unsigned long long int>(line_param, arg_value, "Parameters::parse_params", lang); }
-                    }
-                    else if(p->type_name==typeid(float).name()) {
-                        Param<float>* const p_reint = dynamic_cast<Param<float>* const>(p);
-                        if(p_reint==0) throw DynamicCastFailedException(line_param, "Parameters::parse_params", lang);
-                        try { p_reint->values[j] = std::stof(arg_value); }
-                        catch(const std::invalid_argument& e) { throw DecimalExpectedException(line_param, arg_value, "Parameters::parse_params", lang); }
-                        catch(const std::out_of_range& e)     { throw ValueOutOfRangeException<float>(line_param, arg_value, "Parameters::parse_params", lang); }
-                    }
-                    else if(p->type_name==typeid(double).name()) {
-                        Param<double>* const p_reint = dynamic_cast<Param<double>* const>(p);
-                        if(p_reint==0) throw DynamicCastFailedException(line_param, "Parameters::parse_params", lang);
-                        try { p_reint->values[j] = std::stod(arg_value); }
-                        catch(const std::invalid_argument& e) { throw DecimalExpectedException(line_param, arg_value, "Parameters::parse_params", lang); }
-                        catch(const std::out_of_range& e)     { throw ValueOutOfRangeException<double>(line_param, arg_value, "Parameters::parse_params", lang); }
-                    }
-                    else if(p->type_name==typeid(long double).name()) {
-                        Param<long double>* const p_reint = dynamic_cast<Param<long double>* const>(p);
-                        if(p_reint==0) throw DynamicCastFailedException(line_param, "Parameters::parse_params", lang);
-                        try { p_reint->values[j] = std::stold(arg_value); }
-                        catch(const std::invalid_argument& e) { throw DecimalExpectedException(line_param, arg_value, "Parameters::parse_params", lang); }
-                        catch(const std::out_of_range& e)     { throw ValueOutOfRangeException<long double>(line_param, arg_value, "Parameters::parse_params", lang); }
-                    }
-                    else if(p->type_name==typeid(std::string).name()) {
-                        Param<std::string>* const p_reint = dynamic_cast<Param<std::string>* const>(p);
-                        if(p_reint==0) throw DynamicCastFailedException(line_param, "Parameters::parse_params", lang);
-                        p_reint->values[j] = arg_value;
-                        /* check if available value for multiple choice */
-                        if(choices_params.count(p->name)) {
-                            bool ok = false;
-                            for(const std::pair<std::string, std::string> choice: choices.at(p->name)) {
-                                if(choice.first==arg_value) {
-                                    ok = true;
-                                    break;
-                                }
-                            }
-                            if(!ok) {
-                                throw UnknownChoiceException(p->name, arg_value, "Parameters::parse_params", lang);
-                            }
-                        }
-                    }
-                }
-                else {
-                    throw NotEnoughValuesException(p->name, p->nb_values, static_cast<int>(j), "Parameters::parse_params", lang);
-                }
-            }
-            /* arg is defined */
-            p->is_defined = true;
-        }
-        else {
-            throw UnknownParameterException(line_param, "Parameters::parse_params", lang);
-        }
+PARAMETERS_INLINE const std::string Parameters::positional_use(const ParamHolder* const p) const {
+    std::size_t min = 0;
+    std::size_t max = 0;
+    for(const positional& pos: positionals) if(pos.param==p) { min = pos.min; max = pos.max; }
+    /* optional args between brackets, repeated ones followed by dots */
+    std::string use = "<" + underline(pool.at(p->values_names[0])) + ">";
+    if(max>1)  use += "...";
+    if(min==0) use = "[" + use + "]";
+    return use;
+}
+
+PARAMETERS_INLINE void Parameters::print_subcommands(Renderer& r) const {
+    if(lang==lang_fr) r.write(bold("COMMANDES :") + "\n");
+    else              r.write(bold("COMMANDS:") + "\n");
+    for(const std::string& name: subcommands_order) {
+        /* print name, and description on the same line if it fits */
+        const std::string use              = params_indent + bold(name);
+        const bool        desc_on_new_line = visible_length(use)+param_to_desc_len>desc_indent_len;
+        if(desc_on_new_line) r.write(use + "\n");
+        else                 r.write(use + std::string(static_cast<std::size_t>(desc_indent_len-visible_length(use)), ' '));
+        print_text(view(subcommands.at(name).first), desc_on_new_line, desc_indent_len, desc_indent, nullptr, r);
     }
+    r.write("\n");
 }
 
-const bool Parameters::is_spec(const std::string& param_name) const {
-    if(params.count("--" + param_name)) {
-        ParamHolder* const p = params.at("--" + param_name);
-        return p->is_defined;
+PARAMETERS_INLINE void Parameters::print_constraints(ParamHolder* const p, Renderer& r) const {
+    const std::string range = p->range_text();
+    if(!range.empty()) print_rule(lang==lang_fr ? "Plage :" : "Range:", range, p, r);
+    /* the rules of the param were indexed when they were declared */
+    if(p->id>=rules_of.size()) return;
+    for(const std::size_t i: rules_of[p->id]) print_rule(constraints[i].label, constraints[i].text, p, r);
+}
+
+PARAMETERS_INLINE void Parameters::print_rule(const std::string& label, const std::string& text, ParamHolder* const p, Renderer& r) const {
+    /* the text is aligned after the label, or goes under it if it does not fit and the label takes more than half of the room */
+    const int label_len  = static_cast<int>(label.length());
+    const int room       = terminal_width - right_margin_len - desc_indent_len;
+    const int indent_len = desc_indent_len + label_len + 1;
+    if(label_len+1+visible_length(text)<=room || 2*label_len<=room) {
+        r.write(desc_indent + bold(label) + " ");
+        print_text(view(text), false, indent_len, std::string(static_cast<std::size_t>(indent_len), ' '), p, r);
     }
     else {
-        throw UndefinedParameterException(param_name, "Parameters::is_spec", lang);
+        /* each word of the label in bold, so that the label can be cut like a text */
+        std::string styled_label;
+        std::size_t from = 0;
+        for(std::size_t to ; (to=label.find(' ', from))!=std::string::npos ; from=to+1) styled_label += bold(label.substr(from, to-from)) + " ";
+        styled_label += bold(label.substr(from));
+        print_text(view(styled_label), true, desc_indent_len, desc_indent, nullptr, r, true);
+        print_text(view(text), true, desc_indent_len, desc_indent, p, r);
     }
 }
 
-const std::string Parameters::str_val(const std::string& param_name, const int value_number) const {
-    if(params.count("--" + param_name)) {
-        Parameters::ParamHolder* const p = params.at("--" + param_name);
-        if(value_number>p->nb_values) {
-            throw UndefinedValueException(param_name, p->nb_values, value_number, "Parameters::str_val", lang);
+/*** help search ***/
+
+PARAMETERS_INLINE void Parameters::build_help_index() const {
+    /* words get an id when first seen, with the place they appear at */
+    std::unordered_map<std::string, std::uint32_t>     ids;
+    std::vector<std::string>                           words;
+    std::vector<std::pair<std::uint32_t, posting>>     found;
+    std::string                                        word;
+    ids.reserve(index_words.size());
+    found.reserve(index_postings.size());
+    auto add = [&ids, &words, &found, &word] (const char* const first, const char* const last, const posting& where) {
+        for_each_word(first, last, 2, word, [&ids, &words, &found, &word, &where] () {
+            std::unordered_map<std::string, std::uint32_t>::const_iterator it = ids.find(word);
+            if(it==ids.end()) {
+                it = ids.insert(std::make_pair(word, static_cast<std::uint32_t>(words.size()))).first;
+                words.push_back(word);
+            }
+            found.push_back(std::make_pair(it->second, where));
+        });
+    };
+    for(std::size_t i=0 ; i<order.size() ; i++) {
+        const ParamHolder* const p  = order[i];
+        const std::uint32_t      id = static_cast<std::uint32_t>(i);
+        add(p->name.data() + 2, p->name.data() + p->name.size(), posting{id, field_name, 0});
+        for(const std::uint32_t value_name: p->values_names) {
+            const std::string& name = pool.at(value_name);
+            add(name.data(), name.data() + name.size(), posting{id, field_value, 0});
         }
-        else {
-            /* reinterpret with the good type */
-            Param<std::string>* const p_reint = dynamic_cast<Param<std::string>* const>(p);
-            if(p_reint==0) throw DynamicCastFailedException(param_name, "Parameters::str_val", lang);
-            /* return value */
-            return p_reint->values[static_cast<std::size_t>(value_number-1)];
+        add(p->description.begin(), p->description.end(), posting{id, field_description, 0});
+        const ChoiceParam* const p_choice = choice_cast(p);
+        if(p_choice!=0) {
+            for(std::size_t k=0 ; k<p_choice->choices.size() ; k++) {
+                const std::pair<std::string, std::string>& pc = p_choice->choices[k];
+                add(pc.first.data(),  pc.first.data()  + pc.first.size(),  posting{id, field_choice,             static_cast<std::uint32_t>(k)});
+                add(pc.second.data(), pc.second.data() + pc.second.size(), posting{id, field_choice_description, static_cast<std::uint32_t>(k)});
+            }
         }
     }
-    else {
-        throw UndefinedParameterException(param_name, "Parameters::is_def", lang);
+    /* only the distinct words are sorted, postings are then grouped by word in one counting pass */
+    std::vector<std::uint32_t> by_rank(words.size());
+    for(std::size_t w=0 ; w<words.size() ; w++) by_rank[w] = static_cast<std::uint32_t>(w);
+    std::sort(by_rank.begin(), by_rank.end(), [&words] (const std::uint32_t a, const std::uint32_t b) { return words[a]<words[b]; });
+    std::vector<std::uint32_t> rank(words.size());
+    index_words.clear();
+    index_words.reserve(words.size());
+    for(std::size_t k=0 ; k<by_rank.size() ; k++) {
+        rank[by_rank[k]] = static_cast<std::uint32_t>(k);
+        index_words.push_back(std::move(words[by_rank[k]]));
     }
+    index_starts.assign(words.size() + 1, 0);
+    for(const std::pair<std::uint32_t, posting>& f: found) index_starts[rank[f.first]+1]++;
+    for(std::size_t k=1 ; k<index_starts.size() ; k++) index_starts[k] += index_starts[k-1];
+    std::vector<std::uint32_t> next(index_starts.begin(), index_starts.end() - 1);
+    index_postings.resize(found.size());
+    for(const std::pair<std::uint32_t, posting>& f: found) index_postings[next[rank[f.first]]++] = f.second;
+    indexed_size = order.size();
 }
 
-const std::string Parameters::cho_val(const std::string& param_name) const {
-    if(params.count("--" + param_name)) {
-        Parameters::ParamHolder* const p = params.at("--" + param_name);
-        /* reinterpret with the good type */
-        Param<std::string>* const p_reint = dynamic_cast<Param<std::string>* const>(p);
-        if(p_reint==0) throw DynamicCastFailedException(param_name, "Parameters::cho_val", lang);
-        /* return value */
-        return p_reint->values[0];
+PARAMETERS_INLINE const char* const Parameters::search_magic() {
+    return "H80I";
+}
+
+PARAMETERS_INLINE const unsigned long long Parameters::help_fingerprint() const {
+    /* FNV-1a, like schema_fingerprint, over the texts that are indexed */
+    unsigned long long hash = schema_fingerprint();
+    auto add = [&hash] (const char* first, const char* const last) {
+        for( ; first<last ; first++) { hash ^= static_cast<unsigned char>(*first); hash *= 1099511628211ULL; }
+        hash ^= 0xff; hash *= 1099511628211ULL;
+    };
+    for(const ParamHolder* const p: order) {
+        for(const std::uint32_t value_name: p->values_names) add(pool.at(value_name).data(), pool.at(value_name).data() + pool.at(value_name).size());
+        add(p->description.begin(), p->description.end());
+        const ChoiceParam* const p_choice = choice_cast(p);
+        if(p_choice!=0) {
+            for(const std::pair<std::string, std::string>& pc: p_choice->choices) add(pc.second.data(), pc.second.data() + pc.second.size());
+        }
     }
-    else {
-        throw UndefinedParameterException(param_name, "Parameters::is_def", lang);
+    return hash;
+}
+
+PARAMETERS_INLINE void Parameters::write_search_index(const std::string& path) const {
+    std::string blob(search_magic(), 4);
+    {
+        std::lock_guard<std::mutex> lock(search_mutex);
+        if(indexed_size!=order.size()) build_help_index();
+        put_value<std::uint32_t>(blob, search_version);
+        put_value<unsigned long long>(blob, help_fingerprint());
+        put_value<std::uint32_t>(blob, static_cast<std::uint32_t>(order.size()));
+        put_value<std::uint32_t>(blob, static_cast<std::uint32_t>(index_words.size()));
+        put_value<std::uint32_t>(blob, static_cast<std::uint32_t>(index_postings.size()));
+        for(const std::string& word: index_words)   put_value(blob, word);
+        for(const std::uint32_t start: index_starts) put_value<std::uint32_t>(blob, start);
+        blob.append(reinterpret_cast<const char*>(index_postings.data()), index_postings.size()*sizeof(posting));
+    }
+    std::ofstream out(path, std::ios::binary);
+    out.write(blob.data(), static_cast<std::streamsize>(blob.size()));
+}
+
+PARAMETERS_INLINE const bool Parameters::read_search_index(const std::string& path) const {
+    #if PLATFORM == PLATFORM_MAC || PLATFORM == PLATFORM_UNIX
+        const int fd = open(path.c_str(), O_RDONLY);
+        if(fd<0) return false;
+        struct stat st;
+        if(fstat(fd, &st)!=0 || st.st_size==0) { close(fd); return false; }
+        const std::size_t size = static_cast<std::size_t>(st.st_size);
+        void* const       data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if(data==MAP_FAILED) return false;
+        const bool ok = parse_search_index(static_cast<const char*>(data), size);
+        munmap(data, size);
+        return ok;
+    #else
+        std::ifstream in(path, std::ios::binary);
+        if(!in) return false;
+        const std::string index((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        return parse_search_index(index.data(), index.size());
+    #endif
+}
+
+PARAMETERS_INLINE const bool Parameters::parse_search_index(const char* const data, const std::size_t size) const {
+    const char*        pos         = data;
+    const char* const  end         = data + size;
+    std::uint32_t      version     = 0;
+    unsigned long long fingerprint = 0;
+    std::uint32_t      nb_params   = 0;
+    std::uint32_t      nb_words    = 0;
+    std::uint32_t      nb_postings = 0;
+    /* check header, a word takes at least 4 bytes */
+    if(size<4 || std::memcmp(pos, search_magic(), 4)!=0) return false;
+    pos += 4;
+    if(!get_value(pos, end, version)     || version!=search_version
+    || !get_value(pos, end, fingerprint) || !get_value(pos, end, nb_params) || nb_params!=order.size()
+    || !get_value(pos, end, nb_words)    || nb_words>static_cast<std::size_t>(end-pos)/4
+    || !get_value(pos, end, nb_postings) || fingerprint!=help_fingerprint()) {
+        return false;
     }
+    /* read words, then where each one's postings start, then the postings */
+    std::vector<std::string>   words(nb_words);
+    std::vector<std::uint32_t> starts(nb_words + 1);
+    for(std::string& word: words)     if(!get_value(pos, end, word))  return false;
+    for(std::uint32_t& start: starts) if(!get_value(pos, end, start)) return false;
+    if(starts[0]!=0 || starts[nb_words]!=nb_postings || static_cast<std::size_t>(end-pos)!=nb_postings*sizeof(posting)) return false;
+    for(std::size_t k=0 ; k<nb_words ; k++) if(starts[k]>starts[k+1]) return false;
+    std::vector<posting> postings(nb_postings);
+    if(nb_postings>0) std::memcpy(postings.data(), pos, nb_postings*sizeof(posting));
+    for(const posting& post: postings) if(post.param>=nb_params || post.field>field_choice_description) return false;
+    /* the loaded index replaces the one that would be built */
+    std::lock_guard<std::mutex> lock(search_mutex);
+    index_words.swap(words);
+    index_starts.swap(starts);
+    index_postings.swap(postings);
+    indexed_size = order.size();
+    return true;
 }
+
+PARAMETERS_INLINE const std::size_t Parameters::search_help(const std::string& query) const {
+    std::size_t nb_found = 0;
+    if(terminal_supports_styles()) { AnsiRenderer  r(std::cout); nb_found = search_help(r, query); }
+    else                           { PlainRenderer r(std::cout); nb_found = search_help(r, query); }
+    std::cout << std::flush;
+    return nb_found;
+}
+
+PARAMETERS_INLINE const std::size_t Parameters::search_help(Renderer& r, const std::string& query) const {
+    /* weight of a word by FIELD, a word equal to the searched one counts twice as much as a longer one */
+    static const std::uint32_t field_weights[] = {16, 4, 8, 2, 1};
+    /* the last word may be typed partially, so every word of the query is a prefix */
+    std::vector<std::string> terms;
+    std::string              term;
+    for_each_word(query.data(), query.data() + query.size(), 1, term, [&terms, &term] () { terms.push_back(term); });
+    std::vector<std::uint32_t>                                 scores(order.size(), 0);
+    std::vector<std::uint32_t>                                 matched(order.size(), 0);
+    std::vector<std::uint32_t>                                 best(order.size(), 0);
+    std::vector<std::uint32_t>                                 touched;
+    std::unordered_map<std::uint32_t, std::vector<std::size_t>> shown_choices;
+    {
+        std::lock_guard<std::mutex> lock(search_mutex);
+        if(indexed_size!=order.size()) build_help_index();
+        for(std::size_t t=0 ; t<terms.size() ; t++) {
+            /* a param scores the weight of its best word for the term, and must match all the terms */
+            touched.clear();
+            const std::string& prefix = terms[t];
+            for(std::vector<std::string>::const_iterator w=std::lower_bound(index_words.begin(), index_words.end(), prefix) ;
+                w!=index_words.end() && w->compare(0, prefix.size(), prefix)==0 ; ++w) {
+                const std::size_t   k      = static_cast<std::size_t>(w - index_words.begin());
+                const std::uint32_t factor = w->size()==prefix.size() ? 2 : 1;
+                for(std::uint32_t j=index_starts[k] ; j<index_starts[k+1] ; j++) {
+                    const posting& post = index_postings[j];
+                    if(matched[post.param]!=t) continue;
+                    if(best[post.param]==0) touched.push_back(post.param);
+                    best[post.param] = std::max(best[post.param], field_weights[post.field]*factor);
+                    if(post.field==field_choice || post.field==field_choice_description) shown_choices[post.param].push_back(post.choice);
+                }
+            }
+            for(const std::uint32_t id: touched) {
+                matched[id]++;
+                scores[id] += best[id];
+                best[id]    = 0;
+            }
+        }
+    }
+    /* best scores first, then in definition order */
+    std::vector<std::uint32_t> results;
+    for(std::size_t i=0 ; i<order.size() && !terms.empty() ; i++) {
+        if(matched[i]==terms.size()) results.push_back(static_cast<std::uint32_t>(i));
+    }
+    std::stable_sort(results.begin(), results.end(), [&scores] (const std::uint32_t a, const std::uint32_t b) { return scores[a]>scores[b]; });
+    r.begin();
+    r.write("\n");
+    if(results.empty()) {
+        if(lang==lang_fr) r.write(params_indent + "Aucun paramètre ne correspond à \"" + query + "\".\n\n");
+        else              r.write(params_indent + "No parameter matches \"" + query + "\".\n\n");
+    }
+    for(const std::uint32_t id: results) {
+        /* choices that match are shown alone, all of them if none does */
+        std::vector<std::size_t>& choices = shown_choices[id];
+        std::sort(choices.begin(), choices.end());
+        choices.erase(std::unique(choices.begin(), choices.end()), choices.end());
+        print_param(order[id], r, choices);
+    }
+    r.end();
+    return results.size();
+}
+
+/*** repeated parameters ***/
+
+PARAMETERS_INLINE void Parameters::set_occurrence_policy(const std::string& param_name, const OCCURRENCE policy) {
+    if(params.count("--" + param_name)) {
+        params.at("--" + param_name)->occurrence = policy;
+    }
+    else {
+        PARAMETERS_THROW(UndefinedParameterException(param_name, "Parameters::set_occurrence_policy", lang));
+    }
+}
+
+/*** constraints ***/
+
+PARAMETERS_INLINE void Parameters::add_constraint(const CONSTRAINT kind, const std::string& subject, const std::vector<std::string>& others, const std::size_t n) {
+    /* check names */
+    if((kind==constraint_requires || kind==constraint_conflicts) && !params.count("--" + subject)) {
+        PARAMETERS_THROW(UndefinedParameterException(subject, "Parameters::add_constraint", lang));
+    }
+    for(const std::string& o: others) {
+        if(!params.count("--" + o)) PARAMETERS_THROW(UndefinedParameterException(o, "Parameters::add_constraint", lang));
+    }
+    /* store rule, it will be compiled before the next parsing */
+    constraint c = {kind, subject, others, n, "", ""};
+    if(kind==constraint_requires)       c.label = lang==lang_fr ? "Requiert :"            : "Requires:";
+    else if(kind==constraint_conflicts) c.label = lang==lang_fr ? "Incompatible avec :"   : "Conflicts with:";
+    else if(kind==constraint_one_of)    c.label = lang==lang_fr ? "Exactement un parmi :" : "Exactly one of:";
+    else                                c.label = lang==lang_fr ? "Au plus " + std::to_string(n) + " parmi :" : "At most " + std::to_string(n) + " of:";
+    for(const std::string& o: others) {
+        if(c.text!="") c.text += " ";
+        c.text += "$p(" + o + ")";
+    }
+    const std::size_t rule = constraints.size();
+    constraints.push_back(c);
+    compiled_size = 0;
+    /* index the rule by the params it is printed under: the subject, or each param of the group */
+    auto index_rule = [this, rule] (const std::string& name) {
+        const std::size_t id = params.at("--" + name)->id;
+        if(rules_of.size()<=id) rules_of.resize(id+1);
+        if(rules_of[id].empty() || rules_of[id].back()!=rule) rules_of[id].push_back(rule);
+    };
+    if(kind==constraint_requires || kind==constraint_conflicts) index_rule(subject);
+    else for(const std::string& o: others) index_rule(o);
+}
+
+PARAMETERS_INLINE void Parameters::add_requires(const std::string& param_name, const std::vector<std::string>& required) {
+    add_constraint(constraint_requires, param_name, required, 0);
+}
+
+PARAMETERS_INLINE void Parameters::add_conflicts(const std::string& param_name, const std::vector<std::string>& conflicting) {
+    add_constraint(constraint_conflicts, param_name, conflicting, 0);
+}
+
+PARAMETERS_INLINE void Parameters::add_one_of_group(const std::vector<std::string>& group) {
+    add_constraint(constraint_one_of, "", group, 1);
+}
+
+PARAMETERS_INLINE void Parameters::add_at_most_group(const std::size_t n, const std::vector<std::string>& group) {
+    add_constraint(constraint_at_most, "", group, n);
+}
+
+PARAMETERS_INLINE void Parameters::compile_constraints() {
+    const std::size_t words = (params.size()+63)/64;
+    /* list params with a range */
+    ranged.clear();
+    for(const ParamHolder* const p: order) if(!p->range_text().empty()) ranged.push_back(p->id);
+    /* one mask per rule */
+    compiled.clear();
+    for(const constraint& c: constraints) {
+        compiled_constraint cc;
+        cc.subject = c.subject.empty() ? 0 : params.at("--" + c.subject)->id;
+        cc.others.assign(words, 0);
+        for(const std::string& o: c.others) {
+            const std::size_t id = params.at("--" + o)->id;
+            cc.others[id/64] |= std::uint64_t(1) << (id%64);
+        }
+        compiled.push_back(cc);
+    }
+    given.assign(words, 0);
+    compiled_size = params.size();
+}
+
+PARAMETERS_INLINE void Parameters::check_constraints() {
+    PARAMETERS_TRACE_SCOPE("check_constraints", constraints.size());
+    /* ranges */
+    for(const std::size_t id: ranged) {
+        std::string value;
+        if(order[id]->out_of_bounds(value)) {
+            PARAMETERS_FAIL(error_value_out_of_bounds, ValueOutOfBoundsException(order[id]->name, value, order[id]->range_text(), "Parameters::parse_params", lang));
+        }
+    }
+    /* lambda to get the param of the lowest bit of a word */
+    auto first_param = [this] (const std::size_t w, std::uint64_t bits) {
+        std::size_t bit = 0;
+        while(!(bits & 1)) { bits >>= 1; bit++; }
+        return order[w*64+bit]->name;
+    };
+    /* rules */
+    for(std::size_t i=0 ; i<compiled.size() ; i++) {
+        const constraint&          c  = constraints[i];
+        const compiled_constraint& cc = compiled[i];
+        const bool subject_given = (given[cc.subject/64] >> (cc.subject%64)) & 1;
+        std::size_t count = 0;
+        for(std::size_t w=0 ; w<given.size() ; w++) {
+            if(c.kind==constraint_requires && subject_given) {
+                const std::uint64_t missing = cc.others[w] & ~given[w];
+                if(missing) PARAMETERS_FAIL(error_missing_required, MissingRequiredParameterException("--" + c.subject, first_param(w, missing), "Parameters::parse_params", lang));
+            }
+            else if(c.kind==constraint_conflicts && subject_given) {
+                const std::uint64_t both = cc.others[w] & given[w];
+                if(both) PARAMETERS_FAIL(error_conflicting_parameters, ConflictingParametersException("--" + c.subject, first_param(w, both), "Parameters::parse_params", lang));
+            }
+            else if(c.kind==constraint_one_of || c.kind==constraint_at_most) {
+                count += std::bitset<64>(cc.others[w] & given[w]).count();
+            }
+        }
+        if((c.kind==constraint_one_of && count!=1) || (c.kind==constraint_at_most && count>c.n)) {
+            std::string group;
+            for(const std::string& o: c.others) group += (group=="" ? "\"--" : ", \"--") + o + "\"";
+            PARAMETERS_FAIL(error_group_constraint, GroupConstraintException(group, c.kind==constraint_one_of, c.n, count, "Parameters::parse_params", lang));
+        }
+    }
+}
+
+/*** use parameters ***/
+
+PARAMETERS_INLINE void Parameters::parse_params() {
+    current_error().code = error_none;
+    /* like the other overloads, each call starts from the default values */
+    reset_values();
+    parse_args(argc, argv);
+}
+
+PARAMETERS_INLINE void Parameters::parse_params(const std::string& command) {
+    current_error().code = error_none;
+    /* the buffer keeps its capacity from one command to the next */
+    line_buffer.assign(command);
+    split_command();
+    if(PARAMETERS_FAILED) return;
+    parse_line();
+}
+
+PARAMETERS_INLINE void Parameters::split_command() {
+    line_args.assign(1, argc>0 ? argv[0] : "");
+    /* quotes and escapes are removed by moving chars to the left, so w never passes r */
+    char* const       data = &line_buffer[0];
+    const std::size_t len  = line_buffer.size();
+    std::size_t       r    = 0;
+    std::size_t       w    = 0;
+    for(;;) {
+        while(r<len && std::isspace(static_cast<unsigned char>(data[r]))) r++;
+        if(r==len) break;
+        const std::size_t start  = w;
+        char              quote  = 0;
+        std::size_t       opened = 0;
+        for( ; r<len ; r++) {
+            const char c = data[r];
+            if(quote=='\'') {
+                /* no escape between single quotes */
+                if(c=='\'') quote = 0;
+                else         data[w++] = c;
+            }
+            else if(quote=='"') {
+                /* only \", \\, \$ and \` are escapes between double quotes */
+                if(c=='"')                                                                                                   quote = 0;
+                else if(c=='\\' && r+1<len && (data[r+1]=='"' || data[r+1]=='\\' || data[r+1]=='$' || data[r+1]=='`')) data[w++] = data[++r];
+                else                                                                                                         data[w++] = c;
+            }
+            else if(std::isspace(static_cast<unsigned char>(c))) break;
+            else if(c=='\'' || c=='"') { quote = c; opened = r; }
+            else if(c=='\\' && r+1<len) { if(data[++r]!='\n') data[w++] = data[r]; }
+            else                        data[w++] = c;
+        }
+        if(quote!=0) {
+            PARAMETERS_FAIL(error_unbalanced_quote, UnbalancedQuoteException(quote, opened, "Parameters::parse_params", lang));
+        }
+        /* step over the blank before it is overwritten */
+        if(r<len) r++;
+        data[w++] = '\0';
+        line_args.push_back(data + start);
+    }
+}
+
+PARAMETERS_INLINE void Parameters::parse_line() {
+    reset_values();
+    /* null terminated like argv, so that the args after "--" can be given to execv */
+    line_args.push_back(nullptr);
+    parse_args(static_cast<int>(line_args.size()-1), line_args.data());
+}
+
+PARAMETERS_INLINE void Parameters::reset_values() {
+    for(const std::pair<const std::string, ParamHolder*>& pp: params) pp.second->reset();
+    sub.reset();
+    sub_name = "";
+}
+
+PARAMETERS_INLINE void Parameters::parse_args(const int p_argc, char const* const* const p_argv) {
+    PARAMETERS_TRACE_SCOPE("parse_params", p_argc-1);
+    if(compiled_size!=params.size()) compile_constraints();
+    given.assign(given.size(), 0);
+    rest = Span<const char*>();
+    /* first positional slot that is not full */
+    std::size_t slot = 0;
+    while(slot<positionals.size() && positionals[slot].param->occurrences>=positionals[slot].max) slot++;
+    for(int i=1 ; i<p_argc ; i++) {
+        /* get arg name, positional slots cannot be given by name */
+        const std::string line_param(p_argv[i]);
+        const map_params::const_iterator it = params.find(line_param);
+        map_params::const_iterator       parent_it;
+        if(it!=params.end() && !it->second->positional) {
+            parse_param(it->second, i, p_argc, p_argv);
+            if(PARAMETERS_FAILED) return;
+        }
+        else if(parent && (parent_it=parent->params.find(line_param))!=parent->params.end() && !parent_it->second->positional) {
+            /* global parameter given after the subcommand */
+            parent->parse_param(parent_it->second, i, p_argc, p_argv);
+            if(PARAMETERS_FAILED) return;
+        }
+        else if(subcommands.count(line_param)) {
+            /* the subcommand parses the rest of the line, its name being its argv[0] */
+            sub_name = line_param;
+            sub.reset(new Parameters(p_argc-i, p_argv+i, this));
+            subcommands.at(line_param).second(*sub);
+            sub->parse_params();
+            if(PARAMETERS_FAILED) return;
+            break;
+        }
+        else if(line_param=="--") {
+            /* the rest is left to the caller, straight from argv */
+            rest = Span<const char*>(p_argv+i+1, static_cast<std::size_t>(p_argc-i-1));
+            break;
+        }
+        else if(line_param.compare(0, 2, "--")!=0 && slot<positionals.size()) {
+            parse_positional(positionals[slot], i, p_argc, p_argv);
+            if(PARAMETERS_FAILED) return;
+            while(slot<positionals.size() && positionals[slot].param->occurrences>=positionals[slot].max) slot++;
+        }
+        else if(!subcommands.empty() && line_param.compare(0, 2, "--")!=0) {
+            PARAMETERS_FAIL(error_unknown_subcommand, UnknownSubcommandException(line_param, "Parameters::parse_params", lang));
+        }
+        else {
+            PARAMETERS_FAIL(error_unknown_parameter, UnknownParameterException(line_param, "Parameters::parse_params", lang));
+        }
+    }
+    /* positional slots must have their minimum nb of args */
+    for(const positional& pos: positionals) {
+        if(pos.param->occurrences<pos.min) {
+            PARAMETERS_FAIL(error_not_enough_values, NotEnoughValuesException(pos.param->name.substr(2), static_cast<int>(pos.min), static_cast<int>(pos.param->occurrences), "Parameters::parse_params", lang));
+        }
+    }
+    check_constraints();
+}
+
+PARAMETERS_INLINE void Parameters::parse_positional(const positional& pos, const int i, const int p_argc, char const* const* const p_argv) {
+    ParamHolder* const p = pos.param;
+    /* room for all the args this slot can still take, allocated once */
+    if(p->occurrences++==0) p->reserve_accumulated(std::min(pos.max, static_cast<std::size_t>(p_argc-i)));
+    const char* const arg_value = p_argv[i];
+    PARAMETERS_TRACE_SCOPE("convert", i);
+    p->read_text(0, arg_value, arg_value + std::strlen(arg_value), lang);
+    if(PARAMETERS_FAILED) return;
+    p->accumulate();
+    p->specify(true);
+    given[p->id/64] |= std::uint64_t(1) << (p->id%64);
+}
+
+PARAMETERS_INLINE const Parameters::Span<const char*> Parameters::passthrough() const {
+    return rest;
+}
+
+PARAMETERS_INLINE void Parameters::parse_param(ParamHolder* const p, int& i, const int p_argc, char const* const* const p_argv) {
+    const std::string& line_param = p->name;
+    /* apply occurrence policy */
+    if(++p->occurrences>1) {
+        if(p->occurrence==occurrence_error) {
+            PARAMETERS_FAIL(error_duplicate_occurrence, DuplicateOccurrenceException(p->name, "Parameters::parse_params", lang));
+        }
+        else if(p->occurrence==occurrence_first) {
+            /* skip values */
+            if(i+p->nb_values>=p_argc) {
+                PARAMETERS_FAIL(error_not_enough_values, NotEnoughValuesException(p->name, p->nb_values, p_argc-1-i, "Parameters::parse_params", lang));
+            }
+            i += p->nb_values;
+            return;
+        }
+    }
+    else if(p->occurrence==occurrence_accumulate) {
+        /* count all occurrences once, so that the buffer is allocated once */
+        std::size_t nb = 0;
+        for(int k=i ; k<p_argc ; k++) if(line_param.compare(p_argv[k])==0) nb++;
+        p->reserve_accumulated(nb);
+    }
+    /* read param values, each param parses its own type */
+    for(std::size_t j=0 ; j<static_cast<std::size_t>(p->nb_values) ; j++) {
+        if(++i<p_argc) {
+            const char* const arg_value = p_argv[i];
+            PARAMETERS_TRACE_SCOPE("convert", i);
+            p->read_text(j, arg_value, arg_value + std::strlen(arg_value), lang);
+            if(PARAMETERS_FAILED) return;
+        }
+        else {
+            PARAMETERS_FAIL(error_not_enough_values, NotEnoughValuesException(p->name, p->nb_values, static_cast<int>(j), "Parameters::parse_params", lang));
+        }
+    }
+    /* arg is defined */
+    if(p->occurrence==occurrence_accumulate) p->accumulate();
+    p->specify(true);
+    given[p->id/64] |= std::uint64_t(1) << (p->id%64);
+}
+
+PARAMETERS_INLINE const bool Parameters::has_subcommand() const {
+    return sub!=nullptr;
+}
+
+PARAMETERS_INLINE const std::string& Parameters::subcommand_name() const {
+    return sub_name;
+}
+
+PARAMETERS_INLINE Parameters& Parameters::subcommand() const {
+    if(!sub) PARAMETERS_THROW(UnknownSubcommandException("", "Parameters::subcommand", lang));
+    return *sub;
+}
+
+PARAMETERS_INLINE const bool Parameters::is_spec(const std::string& param_name) const {
+    if(params.count("--" + param_name)) {
+        ParamHolder* const p = params.at("--" + param_name);
+        return p->is_defined;
+    }
+    else {
+        PARAMETERS_THROW(UndefinedParameterException(param_name, "Parameters::is_spec", lang));
+    }
+}
+
+PARAMETERS_INLINE const std::size_t Parameters::occurrences(const std::string& param_name) const {
+    if(params.count("--" + param_name)) {
+        return params.at("--" + param_name)->occurrences;
+    }
+    else {
+        PARAMETERS_THROW(UndefinedParameterException(param_name, "Parameters::occurrences", lang));
+    }
+}
+
+PARAMETERS_INLINE const Parameters::Span<std::string> Parameters::str_vals(const std::string& param_name) const {
+    return num_vals<std::string>(param_name);
+}
+
+PARAMETERS_INLINE const std::string Parameters::str_val(const std::string& param_name, const int value_number) const {
+    if(params.count("--" + param_name)) {
+        Parameters::ParamHolder* const p = params.at("--" + param_name);
+        if(value_number>p->nb_values) {
+            PARAMETERS_THROW(UndefinedValueException(param_name, p->nb_values, value_number, "Parameters::str_val", lang));
+        }
+        else {
+            /* reinterpret with the good type */
+            Param<std::string>* const p_reint = param_cast<std::string>(p);
+            if(p_reint==0) PARAMETERS_THROW(DynamicCastFailedException(param_name, "Parameters::str_val", lang));
+            /* return value */
+            return p_reint->current()[static_cast<std::size_t>(value_number-1)];
+        }
+    }
+    else {
+        PARAMETERS_THROW(UndefinedParameterException(param_name, "Parameters::is_def", lang));
+    }
+}
+
+PARAMETERS_INLINE const std::string& Parameters::cho_val(const std::string& param_name) const {
+    if(params.count("--" + param_name)) {
+        Parameters::ParamHolder* const p = params.at("--" + param_name);
+        /* reinterpret with the good type */
+        ChoiceParam* const p_reint = choice_cast(p);
+        if(p_reint==0) PARAMETERS_THROW(DynamicCastFailedException(param_name, "Parameters::cho_val", lang));
+        /* return interned choice name */
+        return p_reint->choices[p_reint->choice].first;
+    }
+    else {
+        PARAMETERS_THROW(UndefinedParameterException(param_name, "Parameters::is_def", lang));
+    }
+}
+
+PARAMETERS_INLINE const std::size_t Parameters::cho_index(const std::string& param_name) const {
+    if(params.count("--" + param_name)) {
+        Parameters::ParamHolder* const p = params.at("--" + param_name);
+        /* reinterpret with the good type */
+        ChoiceParam* const p_reint = choice_cast(p);
+        if(p_reint==0) PARAMETERS_THROW(DynamicCastFailedException(param_name, "Parameters::cho_index", lang));
+        /* return value */
+        return p_reint->choice;
+    }
+    else {
+        PARAMETERS_THROW(UndefinedParameterException(param_name, "Parameters::cho_index", lang));
+    }
+}
+
+/*** units ***/
+
+PARAMETERS_INLINE const Parameters::unit_family& Parameters::unit_family_of(const UNIT unit) {
+    /* single letters are binary like dd, *B are decimal and *iB binary */
+    static constexpr unit_suffix size_units[] = {
+        {"B",   1ull,                   true},
+        {"k",   1ull << 10,             false},
+        {"K",   1ull << 10,             false}, {"KB", 1000ull,                true}, {"KiB", 1ull << 10, true},
+        {"M",   1ull << 20,             false}, {"MB", 1000000ull,             true}, {"MiB", 1ull << 20, true},
+        {"G",   1ull << 30,             false}, {"GB", 1000000000ull,          true}, {"GiB", 1ull << 30, true},
+        {"T",   1ull << 40,             false}, {"TB", 1000000000000ull,       true}, {"TiB", 1ull << 40, true},
+        {"P",   1ull << 50,             false}, {"PB", 1000000000000000ull,    true}, {"PiB", 1ull << 50, true},
+        {"E",   1ull << 60,             false}, {"EB", 1000000000000000000ull, true}, {"EiB", 1ull << 60, true}
+    };
+    static constexpr unit_suffix duration_units[] = {
+        {"ns",  1ull,                   true},
+        {"us",  1000ull,                true},
+        {"ms",  1000000ull,             true},
+        {"s",   1000000000ull,          true},
+        {"m",   60000000000ull,         false},
+        {"min", 60000000000ull,         true},
+        {"h",   3600000000000ull,       true},
+        {"d",   86400000000000ull,      true}
+    };
+    static constexpr unit_suffix count_units[] = {
+        {"k",   1000ull,                true},
+        {"K",   1000ull,                false},
+        {"M",   1000000ull,             true},
+        {"G",   1000000000ull,          true},
+        {"T",   1000000000000ull,       true},
+        {"P",   1000000000000000ull,    true},
+        {"E",   1000000000000000000ull, true}
+    };
+    /* indexed by UNIT */
+    static constexpr unit_family families[] = {
+        {size_units,     sizeof(size_units)/sizeof(unit_suffix),     1ull,          "B",  "bytes"},
+        {duration_units, sizeof(duration_units)/sizeof(unit_suffix), 1ull,          "ns", "ns"},
+        {duration_units, sizeof(duration_units)/sizeof(unit_suffix), 1000ull,       "us", "us"},
+        {duration_units, sizeof(duration_units)/sizeof(unit_suffix), 1000000ull,    "ms", "ms"},
+        {duration_units, sizeof(duration_units)/sizeof(unit_suffix), 1000000000ull, "s",  "s"},
+        {count_units,    sizeof(count_units)/sizeof(unit_suffix),    1ull,          "",   "units"}
+    };
+    return families[unit];
+}
+
+PARAMETERS_INLINE const Parameters::PARSE Parameters::scale_unit(const UNIT unit, const char* c, const char* const last, bool& negative, std::uint64_t& magnitude) {
+    const unit_family&  family = unit_family_of(unit);
+    const std::uint64_t max    = std::numeric_limits<std::uint64_t>::max();
+    /* sign, then digits with an optional decimal part, read in the same pass */
+    negative = c<last && *c=='-';
+    if(c<last && (*c=='-' || *c=='+')) c++;
+    std::uint64_t n           = 0;
+    int           nb_decimals = 0;
+    bool          has_digits  = false;
+    bool          has_point   = false;
+    for( ; c<last ; c++) {
+        if(*c>='0' && *c<='9') {
+            const std::uint64_t digit = static_cast<std::uint64_t>(*c-'0');
+            if(n>(max-digit)/10) return parse_out_of_range;
+            n = n*10 + digit;
+            if(has_point) nb_decimals++;
+            has_digits = true;
+        }
+        else if(*c=='.' && !has_point) has_point = true;
+        else break;
+    }
+    if(!has_digits) return parse_invalid;
+    /* the rest is the unit, the base unit if there is none */
+    std::uint64_t factor = family.base;
+    if(c<last) {
+        const std::size_t        len = static_cast<std::size_t>(last-c);
+        const unit_suffix*       u   = family.suffixes;
+        const unit_suffix* const end = family.suffixes + family.nb_suffixes;
+        while(u!=end && (std::strlen(u->suffix)!=len || std::memcmp(u->suffix, c, len)!=0)) u++;
+        if(u==end) return parse_invalid;
+        factor = u->factor;
+    }
+    /* divide before multiplying when possible, so that large values in large units fit */
+    std::uint64_t divisor = family.base;
+    if(factor%divisor==0) { factor /= divisor; divisor = 1; }
+    while(nb_decimals>0 && factor%10==0) { factor /= 10; nb_decimals--; }
+    while(nb_decimals>0 && n%10==0)      { n /= 10;      nb_decimals--; }
+    if(n>max/factor) return parse_out_of_range;
+    n *= factor;
+    /* the result must be a whole number of base units */
+    for( ; nb_decimals>0 ; nb_decimals--) {
+        if(n%10!=0) return parse_invalid;
+        n /= 10;
+    }
+    if(n%divisor!=0) return parse_invalid;
+    magnitude = n/divisor;
+    return parse_ok;
+}
+
+PARAMETERS_INLINE const std::string Parameters::unit_text(const UNIT unit, const bool negative, const std::uint64_t magnitude) {
+    const unit_family& family = unit_family_of(unit);
+    /* largest unit that divides the value, among the ones at least as large as the base unit */
+    std::uint64_t best   = 1;
+    const char*   suffix = family.base_suffix;
+    if(magnitude!=0) {
+        for(std::size_t i=0 ; i<family.nb_suffixes ; i++) {
+            const unit_suffix& u = family.suffixes[i];
+            if(!u.shown || u.factor%family.base!=0) continue;
+            const std::uint64_t factor = u.factor/family.base;
+            if(factor>best && magnitude%factor==0) { best = factor; suffix = u.suffix; }
+        }
+    }
+    return (negative ? "-" : "") + std::to_string(magnitude/best) + suffix;
+}
+
+PARAMETERS_INLINE const std::string Parameters::unit_base(const UNIT unit) {
+    return unit_family_of(unit).base_name;
+}
+
+PARAMETERS_INLINE const std::string Parameters::unit_list(const UNIT unit) {
+    const unit_family& family = unit_family_of(unit);
+    std::string list;
+    for(std::size_t i=0 ; i<family.nb_suffixes ; i++) {
+        if(i>0) list += ", ";
+        list += family.suffixes[i].suffix;
+    }
+    return list;
+}
+
+
+/*** snapshots ***/
+
+PARAMETERS_INLINE const char* const Parameters::snapshot_magic() {
+    return "H80S";
+}
+
+PARAMETERS_INLINE void Parameters::put_value(std::string& blob, const std::string& value) {
+    put_value<std::uint32_t>(blob, static_cast<std::uint32_t>(value.size()));
+    blob += value;
+}
+
+PARAMETERS_INLINE const bool Parameters::get_value(const char*& pos, const char* const end, std::string& value) {
+    std::uint32_t len = 0;
+    if(!get_value(pos, end, len) || static_cast<std::size_t>(end-pos)<len) return false;
+    value.assign(pos, len);
+    pos += len;
+    return true;
+}
+
+PARAMETERS_INLINE void Parameters::put_value(std::string& blob, const bool value) {
+    put_value<std::uint8_t>(blob, value ? 1 : 0);
+}
+
+PARAMETERS_INLINE const bool Parameters::get_value(const char*& pos, const char* const end, bool& value) {
+    /* another byte would not be a valid bool once copied */
+    std::uint8_t byte = 0;
+    if(!get_value(pos, end, byte) || byte>1) return false;
+    value = byte==1;
+    return true;
+}
+
+PARAMETERS_INLINE const unsigned long long Parameters::schema_fingerprint() const {
+    /* FNV-1a over everything that determines the layout of the values */
+    unsigned long long hash = 14695981039346656037ULL;
+    auto add = [&hash] (const std::string& str) {
+        for(const char c: str) { hash ^= static_cast<unsigned char>(c); hash *= 1099511628211ULL; }
+        hash ^= 0xff; hash *= 1099511628211ULL;
+    };
+    for(const ParamHolder* const p: order) {
+        add(p->name);
+        add(p->type_name);
+        add(std::to_string(p->nb_values));
+        const ChoiceParam* const p_choice = choice_cast(p);
+        if(p_choice!=0) {
+            for(const std::pair<std::string, std::string>& pc: p_choice->choices) add(pc.first);
+        }
+    }
+    return hash;
+}
+
+PARAMETERS_INLINE const std::string Parameters::snapshot() const {
+    std::string blob(snapshot_magic(), 4);
+    put_value<std::uint32_t>(blob, snapshot_version);
+    put_value<unsigned long long>(blob, schema_fingerprint());
+    put_value<std::uint32_t>(blob, static_cast<std::uint32_t>(order.size()));
+    for(const ParamHolder* const p: order) {
+        put_value<std::uint8_t>(blob, p->is_defined ? 1 : 0);
+        put_value<std::uint32_t>(blob, static_cast<std::uint32_t>(p->occurrences));
+        p->write_values(blob);
+    }
+    put_value(blob, sub_name);
+    put_value(blob, sub ? sub->snapshot() : std::string());
+    return blob;
+}
+
+PARAMETERS_INLINE void Parameters::attach_snapshot(const char* const data, const std::size_t size) {
+    current_error().code = error_none;
+    const char*       pos = data;
+    const char* const end = data + size;
+    std::uint32_t      version     = 0;
+    unsigned long long fingerprint = 0;
+    std::uint32_t      nb_params   = 0;
+    /* check header */
+    if(size<4 || std::memcmp(pos, snapshot_magic(), 4)!=0) {
+        PARAMETERS_FAIL(error_invalid_snapshot, InvalidSnapshotException("Parameters::attach_snapshot", lang));
+    }
+    pos += 4;
+    if(!get_value(pos, end, version)        || version!=snapshot_version
+    || !get_value(pos, end, fingerprint)    || fingerprint!=schema_fingerprint()
+    || !get_value(pos, end, nb_params)      || nb_params!=order.size()) {
+        PARAMETERS_FAIL(error_invalid_snapshot, InvalidSnapshotException("Parameters::attach_snapshot", lang));
+    }
+    /* check the values of every param before any of them is changed */
+    const char* const values = pos;
+    for(const ParamHolder* const p: order) {
+        std::uint8_t  is_defined  = 0;
+        std::uint32_t occurrences = 0;
+        if(!get_value(pos, end, is_defined) || !get_value(pos, end, occurrences) || !p->skip_values(pos, end)) {
+            PARAMETERS_FAIL(error_invalid_snapshot, InvalidSnapshotException("Parameters::attach_snapshot", lang));
+        }
+    }
+    /* then the subcommand, checked by attaching its snapshot to a new object */
+    std::string name;
+    std::string child;
+    if(!get_value(pos, end, name) || !get_value(pos, end, child) || pos!=end
+    || (name.empty() ? !child.empty() : subcommands.count(name)==0)) {
+        PARAMETERS_FAIL(error_invalid_snapshot, InvalidSnapshotException("Parameters::attach_snapshot", lang));
+    }
+    std::unique_ptr<Parameters> attached;
+    if(!name.empty()) {
+        attached.reset(new Parameters(0, nullptr, this));
+        subcommands.at(name).second(*attached);
+        attached->attach_snapshot(child.data(), child.size());
+        if(PARAMETERS_FAILED) return;
+    }
+    /* read values, they were all checked */
+    pos = values;
+    for(ParamHolder* const p: order) {
+        std::uint8_t  is_defined  = 0;
+        std::uint32_t occurrences = 0;
+        get_value(pos, end, is_defined);
+        get_value(pos, end, occurrences);
+        p->read_values(pos, end);
+        p->specify(is_defined!=0);
+        p->occurrences = occurrences;
+    }
+    sub      = std::move(attached);
+    sub_name = name;
+    rest     = Span<const char*>();
+}
+
+/*** published snapshots ***/
+
+/*
+    Readers are protected with epochs. A reader stores the current epoch in its slot before
+    loading the snapshot pointer, and clears it when done. A writer swaps the pointer, then
+    increments the epoch and retires the old snapshot with the epoch it had before. A retired
+    snapshot can be freed once every active reader announced a greater epoch: those readers
+    loaded the pointer after the swap.
+*/
+
+PARAMETERS_INLINE Parameters::reader_table& Parameters::readers() {
+    /* constant initialization: the epochs start at 0, the global epoch at 1 */
+    static reader_table table = {{1}, {}, {}};
+    return table;
+}
+
+PARAMETERS_INLINE std::size_t& Parameters::read_guards_depth() {
+    static thread_local std::size_t depth = 0;
+    return depth;
+}
+
+PARAMETERS_INLINE const std::size_t Parameters::acquire_reader_slot() {
+    /* a slot is held by an outer guard, the slot a thread had last time is tried first */
+    static thread_local std::size_t last = 0;
+    for(;;) {
+        for(std::size_t n=0 ; n<max_readers ; n++) {
+            const std::size_t i        = (last+n) % max_readers;
+            bool              expected = false;
+            if(!readers().slots[i].load(std::memory_order_relaxed) && readers().slots[i].compare_exchange_strong(expected, true)) {
+                last = i;
+                return i;
+            }
+        }
+        /* all slots are held by guards of other threads, wait for one of them to end */
+        std::this_thread::yield();
+    }
+}
+
+PARAMETERS_INLINE void Parameters::reclaim() {
+    unsigned long long min_epoch = std::numeric_limits<unsigned long long>::max();
+    for(std::size_t i=0 ; i<max_readers ; i++) {
+        const unsigned long long e = readers().epochs[i].load();
+        if(e!=0 && e<min_epoch) min_epoch = e;
+    }
+    std::size_t kept = 0;
+    for(std::size_t i=0 ; i<retired.size() ; i++) {
+        if(retired[i].second<min_epoch) delete retired[i].first;
+        else                            retired[kept++] = retired[i];
+    }
+    retired.resize(kept);
+}
+
+PARAMETERS_INLINE void Parameters::publish() {
+    std::lock_guard<std::mutex> lock(publish_mutex);
+    publish_locked();
+}
+
+PARAMETERS_INLINE void Parameters::publish_locked() {
+    const Snapshot* const old = current.exchange(new Snapshot(*this));
+    if(old) retired.push_back(std::make_pair(old, readers().epoch.fetch_add(1)));
+    reclaim();
+}
+
+PARAMETERS_INLINE void Parameters::reparse(const int p_argc, char const* const* const p_argv) {
+    /* the lock is held until the parsed values are published, so they are the ones published */
+    std::lock_guard<std::mutex> lock(publish_mutex);
+    current_error().code = error_none;
+    reset_values();
+    /* lambda function to go back to the published values, readers never saw the parsed ones */
+    auto restore = [this] () {
+        const Snapshot* const s = current.load();
+        if(s) attach_snapshot(s->blob.data(), s->blob.size());
+    };
+    PARAMETERS_TRY {
+        parse_args(p_argc, p_argv);
+    }
+    PARAMETERS_CATCH_ALL {
+        restore();
+        PARAMETERS_RETHROW;
+    }
+    if(PARAMETERS_FAILED) {
+        /* attaching clears the error, it is kept for the caller */
+        const error_state failed = current_error();
+        restore();
+        current_error() = failed;
+        return;
+    }
+    publish_locked();
+}
+
+PARAMETERS_INLINE Parameters::Snapshot::Snapshot(const Parameters& p):
+    schema(p),
+    blob(p.snapshot()),
+    offsets(p.params.size()) {
+    const char*       pos = blob.data() + snapshot_header_len;
+    const char* const end = blob.data() + blob.size();
+    for(const ParamHolder* const q: schema.order) {
+        pos += snapshot_param_header_len;
+        offsets[q->id] = static_cast<std::size_t>(pos-blob.data());
+        q->skip_values(pos, end);
+    }
+}
+
+PARAMETERS_INLINE const Parameters::ParamHolder* const Parameters::Snapshot::find(const std::string& param_name, const int value_number, const std::string& function) const {
+    const map_params::const_iterator it = schema.params.find("--" + param_name);
+    if(it==schema.params.end()) {
+        PARAMETERS_THROW(UndefinedParameterException(param_name, function, schema.lang));
+    }
+    if(value_number>it->second->nb_values) {
+        PARAMETERS_THROW(UndefinedValueException(param_name, it->second->nb_values, value_number, function, schema.lang));
+    }
+    return it->second;
+}
+
+PARAMETERS_INLINE const std::string Parameters::Snapshot::str_val(const std::string& param_name, const int value_number) const {
+    const ParamHolder* const p = find(param_name, value_number, "Parameters::Snapshot::str_val");
+    if(param_cast<std::string>(p)==0) PARAMETERS_THROW(DynamicCastFailedException(param_name, "Parameters::Snapshot::str_val", schema.lang));
+    const char*       pos = blob.data() + offsets[p->id];
+    const char* const end = blob.data() + blob.size();
+    std::string value;
+    for(int j=0 ; j<value_number ; j++) get_value(pos, end, value);
+    return value;
+}
+
+PARAMETERS_INLINE const std::size_t Parameters::Snapshot::cho_index(const std::string& param_name) const {
+    const ParamHolder* const  p       = find(param_name, 1, "Parameters::Snapshot::cho_index");
+    const ChoiceParam* const p_reint = choice_cast(p);
+    if(p_reint==0) PARAMETERS_THROW(DynamicCastFailedException(param_name, "Parameters::Snapshot::cho_index", schema.lang));
+    const char* pos = blob.data() + offsets[p->id];
+    std::string value;
+    get_value(pos, blob.data()+blob.size(), value);
+    return p_reint->index.at(value);
+}
+
+PARAMETERS_INLINE const std::string& Parameters::Snapshot::cho_val(const std::string& param_name) const {
+    const std::size_t        choice  = cho_index(param_name);
+    const ChoiceParam* const p_reint = choice_cast(schema.params.at("--" + param_name));
+    return p_reint->choices[choice].first;
+}
+
+PARAMETERS_INLINE const bool Parameters::Snapshot::is_spec(const std::string& param_name) const {
+    const ParamHolder* const p = find(param_name, 0, "Parameters::Snapshot::is_spec");
+    return blob[offsets[p->id]-snapshot_param_header_len]!=0;
+}
+
+PARAMETERS_INLINE Parameters::ReadGuard::ReadGuard(const Parameters& p):
+    outer(read_guards_depth()++==0),
+    slot(outer ? acquire_reader_slot() : max_readers),
+    snapshot(nullptr) {
+    /* announce the epoch before loading the pointer */
+    if(outer) readers().epochs[slot].store(readers().epoch.load());
+    snapshot = p.current.load();
+    if(snapshot==nullptr) {
+        /* the destructor is not called, the slot is given back before throwing */
+        if(outer) {
+            readers().epochs[slot].store(0);
+            readers().slots[slot].store(false);
+        }
+        read_guards_depth()--;
+        PARAMETERS_THROW(NothingPublishedException("Parameters::ReadGuard::ReadGuard", p.lang));
+    }
+}
+
+PARAMETERS_INLINE Parameters::ReadGuard::~ReadGuard() {
+    if(outer) {
+        readers().epochs[slot].store(0);
+        readers().slots[slot].store(false);
+    }
+    read_guards_depth()--;
+}
+
+/*** shell completion ***/
+
+/*
+    The index is a text file: a header line, the nb of entries and the offset of each entry in
+    the file, then one line per parameter or subcommand sorted by name. Numbers are written on
+    index_num_len digits, so the offsets can be searched in place. Each line holds the name,
+    the values names and the choices, separated by tabulations. Values names and choices are
+    separated by the unit separator character. Subcommands are the names without "--".
+*/
+PARAMETERS_INLINE const char* const Parameters::index_header() {
+    return "help80-index 2\n";
+}
+
+PARAMETERS_INLINE const std::string Parameters::build_completion_index() const {
+    std::vector<std::string> entries;
+    /* a subcommand also takes the params of the main command it does not hide */
+    std::vector<std::pair<const Parameters*, const ParamHolder*>> all;
+    for(const std::pair<const std::string, ParamHolder*>& pp: params) all.push_back(std::make_pair(this, pp.second));
+    if(parent) for(const std::pair<const std::string, ParamHolder*>& pp: parent->params) if(!params.count(pp.first)) all.push_back(std::make_pair(parent, pp.second));
+    for(const std::pair<const Parameters*, const ParamHolder*>& owned: all) {
+        const ParamHolder* const p = owned.second;
+        if(p->positional) continue;
+        std::string entry = p->name + '\t';
+        for(std::size_t j=0 ; j<p->values_names.size() ; j++) {
+            if(j>0) entry += index_sep;
+            entry += owned.first->pool.at(p->values_names[j]);
+        }
+        entry += '\t';
+        const ChoiceParam* const p_choice = choice_cast(p);
+        if(p_choice!=0) {
+            const vec_choices& vc = p_choice->choices;
+            for(std::size_t j=0 ; j<vc.size() ; j++) {
+                if(j>0) entry += index_sep;
+                entry += vc[j].first;
+            }
+        }
+        entries.push_back(entry + '\n');
+    }
+    for(const std::string& name: subcommands_order) entries.push_back(name + "\t\t\n");
+    /* the tabulation is lower than any char of a name, so lines are sorted by name */
+    std::sort(entries.begin(), entries.end());
+    /* lambda to write a number on index_num_len digits */
+    auto number = [] (std::size_t n) {
+        std::string str(index_num_len, '0');
+        for(std::size_t j=index_num_len ; j>0 && n>0 ; j--, n/=10) str[j-1] = static_cast<char>('0' + n%10);
+        return str + '\n';
+    };
+    const std::size_t index_header_len = std::strlen(index_header());
+    std::string       index(index_header());
+    index += number(entries.size());
+    std::size_t offset = index_header_len + (entries.size()+1)*(index_num_len+1);
+    for(const std::string& entry: entries) { index += number(offset); offset += entry.size(); }
+    for(const std::string& entry: entries) index += entry;
+    return index;
+}
+
+PARAMETERS_INLINE void Parameters::complete_query(const char* const data, const std::size_t size, const int p_argc, char const* const* const p_argv) {
+    /* argv[1] is "--__complete", the last word is the one being completed */
+    const char* const end     = data + size;
+    const char* const prefix  = p_argc>2 ? p_argv[p_argc-1] : "";
+    const std::size_t pre_len = std::strlen(prefix);
+    std::string       out;
+    /* lambda to read the number at pos, or size if it is not one */
+    auto number = [data, size] (const std::size_t pos) {
+        std::size_t n = 0;
+        if(pos+index_num_len>size) return size;
+        for(std::size_t j=0 ; j<index_num_len ; j++) {
+            const char c = data[pos+j];
+            if(c<'0' || c>'9') return size;
+            n = n*10 + static_cast<std::size_t>(c-'0');
+        }
+        return n;
+    };
+    /* an index cut short answers nothing rather than reading past its end */
+    const std::size_t index_header_len = std::strlen(index_header());
+    const std::size_t nb_entries       = number(index_header_len);
+    const std::size_t table            = index_header_len + index_num_len + 1;
+    if(nb_entries>=size || table+nb_entries*(index_num_len+1)>size) return;
+    /* lambda to cut entry k into its three fields */
+    auto read_entry = [&number, data, end, table] (const std::size_t k, const char** fields, std::size_t* lens) {
+        const std::size_t offset = number(table + k*(index_num_len+1));
+        const char*       pos    = data + std::min(offset, static_cast<std::size_t>(end-data));
+        for(int f=0 ; f<3 ; f++) {
+            const char* stop = pos;
+            while(stop<end && *stop!='\t' && *stop!='\n') stop++;
+            fields[f] = pos;
+            lens[f]   = static_cast<std::size_t>(stop-pos);
+            pos       = stop<end ? stop+1 : end;
+        }
+    };
+    /* lambda to find the first entry whose name is not lower than word, by binary search on the offsets */
+    auto lower_entry = [&read_entry, nb_entries] (const char* const word, const std::size_t word_len) {
+        std::size_t first = 0;
+        std::size_t count = nb_entries;
+        while(count>0) {
+            const std::size_t half = count/2;
+            const char* fields[3];
+            std::size_t lens[3];
+            read_entry(first+half, fields, lens);
+            const int cmp = std::memcmp(fields[0], word, std::min(lens[0], word_len));
+            if(cmp<0 || (cmp==0 && lens[0]<word_len)) { first += half+1; count -= half+1; }
+            else                                        count  = half;
+        }
+        return first;
+    };
+    /* lambda to append the elements of a field that start with the prefix */
+    auto add_matches = [&out, prefix, pre_len] (const char* field, const std::size_t len) {
+        const char* const f_end = field + len;
+        while(field<f_end) {
+            const char* stop = field;
+            while(stop<f_end && *stop!=index_sep) stop++;
+            if(static_cast<std::size_t>(stop-field)>=pre_len && std::strncmp(field, prefix, pre_len)==0) {
+                out.append(field, static_cast<std::size_t>(stop-field));
+                out += '\n';
+            }
+            field = stop+1;
+        }
+    };
+    /* walk the previous words to know if the last one is the value of a parameter */
+    bool subcommand_given = false;
+    for(int i=2 ; i<p_argc-1 ; i++) {
+        const std::size_t word_len = std::strlen(p_argv[i]);
+        const std::size_t k        = lower_entry(p_argv[i], word_len);
+        if(k==nb_entries) continue;
+        const char* fields[3];
+        std::size_t lens[3];
+        read_entry(k, fields, lens);
+        if(lens[0]!=word_len || std::strncmp(fields[0], p_argv[i], word_len)!=0) continue;
+        if(p_argv[i][0]!='-') { subcommand_given = true; continue; }
+        /* parameter found, count its values */
+        int nb_values = lens[1] ? 1 : 0;
+        for(std::size_t j=0 ; j<lens[1] ; j++) if(fields[1][j]==index_sep) nb_values++;
+        if(i+nb_values>=p_argc-1) {
+            if(lens[2]) {
+                /* multiple choice value */
+                add_matches(fields[2], lens[2]);
+            }
+            else {
+                /* value placeholder */
+                const char* name     = fields[1];
+                const char* name_end = fields[1] + lens[1];
+                for(int j=i+1 ; j<p_argc-1 ; j++) name = static_cast<const char*>(std::memchr(name, index_sep, static_cast<std::size_t>(name_end-name))) + 1;
+                const char* stop = name;
+                while(stop<name_end && *stop!=index_sep) stop++;
+                out += "<" + std::string(name, stop) + ">\n";
+            }
+            std::cout << out << std::flush;
+            return;
+        }
+        i += nb_values;
+    }
+    /* complete parameter or subcommand name, the names starting with the prefix follow each other */
+    for(std::size_t k=lower_entry(prefix, pre_len) ; k<nb_entries ; k++) {
+        const char* fields[3];
+        std::size_t lens[3];
+        read_entry(k, fields, lens);
+        if(lens[0]<pre_len || std::strncmp(fields[0], prefix, pre_len)!=0) break;
+        if(subcommand_given && fields[0][0]!='-') continue;
+        out.append(fields[0], lens[0]);
+        out += '\n';
+    }
+    std::cout << out << std::flush;
+}
+
+PARAMETERS_INLINE const bool Parameters::complete() const {
+    if(argc<2) return false;
+    if(std::strcmp(argv[1], "--__complete")==0) {
+        /* once a subcommand is given, its params are defined and it answers for the words after it */
+        for(int i=2 ; i<argc-1 ; i++) {
+            const map_params::const_iterator it = params.find(argv[i]);
+            if(it!=params.end() && !it->second->positional) i += it->second->nb_values;
+            else if(subcommands.count(argv[i])) {
+                std::vector<char const*> words = {argv[0], argv[1]};
+                words.insert(words.end(), argv+i+1, argv+argc);
+                /* the child only reads the settings and params of its parent */
+                Parameters child(static_cast<int>(words.size()), words.data(), const_cast<Parameters*>(this));
+                subcommands.at(argv[i]).second(child);
+                return child.complete();
+            }
+        }
+        const std::string index = build_completion_index();
+        complete_query(index.data(), index.size(), argc, argv);
+        return true;
+    }
+    else if(std::strcmp(argv[1], "--__complete_script")==0 && argc>2) {
+        const std::string shell(argv[2]);
+        if(shell=="bash")      print_completion_script(shell_bash);
+        else if(shell=="zsh")  print_completion_script(shell_zsh);
+        else if(shell=="fish") print_completion_script(shell_fish);
+        return true;
+    }
+    return false;
+}
+
+PARAMETERS_INLINE void Parameters::print_completion_script(const SHELL shell) const {
+    /* program name without its path */
+    std::string prog = argc>0 ? argv[0] : "";
+    const std::size_t slash = prog.find_last_of("/\\");
+    if(slash!=std::string::npos) prog = prog.substr(slash+1);
+    std::string func = "_" + prog + "_complete";
+    for(char& c: func) if(!std::isalnum(static_cast<unsigned char>(c))) c = '_';
+    /* value placeholders such as "<value>" are shown but never inserted */
+    if(shell==shell_bash) {
+        std::cout << func << "() {" << std::endl
+                  << "    local IFS=$'\\n'" << std::endl
+                  << "    COMPREPLY=($(" << prog << " --__complete \"${COMP_WORDS[@]:1:$COMP_CWORD}\"))" << std::endl
+                  << "    [[ ${COMPREPLY[0]} == \\<* ]] && COMPREPLY=()" << std::endl
+                  << "}" << std::endl
+                  << "complete -o default -F " << func << " " << prog << std::endl;
+    }
+    else if(shell==shell_zsh) {
+        std::cout << "#compdef " << prog << std::endl
+                  << func << "() {" << std::endl
+                  << "    local -a candidates" << std::endl
+                  << "    candidates=(\"${(@f)$(" << prog << " --__complete \"${(@)words[2,CURRENT]}\")}\")" << std::endl
+                  << "    [[ -z ${candidates[1]} ]] && return 1" << std::endl
+                  << "    if [[ ${candidates[1]} == \\<* ]]; then _message ${candidates[1]}; else compadd -a candidates; fi" << std::endl
+                  << "}" << std::endl
+                  << "compdef " << func << " " << prog << std::endl;
+    }
+    else if(shell==shell_fish) {
+        std::cout << "function " << func << std::endl
+                  << "    set -l tokens (commandline -opc)" << std::endl
+                  << "    set -e tokens[1]" << std::endl
+                  << "    set -l current (commandline -ct)" << std::endl
+                  << "    " << prog << " --__complete $tokens \"$current\" | string match -v '<*'" << std::endl
+                  << "end" << std::endl
+                  << "complete -c " << prog << " -f -a '(" << func << ")'" << std::endl;
+    }
+}
+
+PARAMETERS_INLINE void Parameters::write_completion_index(const std::string& path) const {
+    const std::string index = build_completion_index();
+    std::ofstream out(path, std::ios::binary);
+    out.write(index.data(), static_cast<std::streamsize>(index.size()));
+}
+
+PARAMETERS_INLINE const bool Parameters::complete_from_index(const int p_argc, char const* const* const p_argv, const std::string& path) {
+    if(p_argc<2 || std::strcmp(p_argv[1], "--__complete")!=0) return false;
+    const std::size_t index_header_len = std::strlen(index_header());
+    #if PLATFORM == PLATFORM_MAC || PLATFORM == PLATFORM_UNIX
+        /* map the index, the schema is never built */
+        const int fd = open(path.c_str(), O_RDONLY);
+        if(fd<0) return false;
+        struct stat st;
+        if(fstat(fd, &st)!=0 || static_cast<std::size_t>(st.st_size)<index_header_len) { close(fd); return false; }
+        const std::size_t size = static_cast<std::size_t>(st.st_size);
+        void* const       data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if(data==MAP_FAILED) return false;
+        const bool ok = std::memcmp(data, index_header(), index_header_len)==0;
+        if(ok) complete_query(static_cast<const char*>(data), size, p_argc, p_argv);
+        munmap(data, size);
+        return ok;
+    #else
+        std::ifstream in(path, std::ios::binary);
+        if(!in) return false;
+        const std::string index((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        const bool ok = index.compare(0, index_header_len, index_header())==0;
+        if(ok) complete_query(index.data(), index.size(), p_argc, p_argv);
+        return ok;
+    #endif
+}
+
+/*** tracing ***/
+
+/*
+    Each thread writes its events to its own ring, with no lock: the fields of an event are
+    atomic, and its seq is cleared before they are written and set after. dump_trace keeps an
+    event only if its seq is the same before and after the fields are read, so events written
+    during the dump are skipped instead of being read half written.
+*/
+PARAMETERS_INLINE const std::uint64_t Parameters::trace_clock() {
+    return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+PARAMETERS_INLINE Parameters::trace_registry& Parameters::tracer() {
+    /* threads can still write events while statics are destroyed at exit */
+    static trace_registry* const registry = new trace_registry();
+    return *registry;
+}
+
+PARAMETERS_INLINE void Parameters::record_trace(const char* const name, const long long arg, const std::uint64_t start, const std::uint64_t stop) {
+    /* each thread takes a free buffer at its first event, and gives it back when it exits */
+    struct thread_buffer {
+        trace_buffer* buffer;
+        std::uint32_t tid;
+        thread_buffer(): buffer(nullptr), tid(0) {}
+        ~thread_buffer() { if(buffer) buffer->owned.store(false, std::memory_order_release); }
+    };
+    static thread_local thread_buffer this_thread;
+    if(this_thread.buffer==nullptr) {
+        trace_registry& registry = tracer();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        for(const std::unique_ptr<trace_buffer>& b: registry.buffers) {
+            bool expected = false;
+            if(b->owned.compare_exchange_strong(expected, true, std::memory_order_acquire)) { this_thread.buffer = b.get(); break; }
+        }
+        if(this_thread.buffer==nullptr) {
+            registry.buffers.emplace_back(new trace_buffer());
+            this_thread.buffer = registry.buffers.back().get();
+            this_thread.buffer->owned.store(true, std::memory_order_relaxed);
+        }
+        this_thread.tid = ++registry.next_tid;
+    }
+    trace_buffer&       b = *this_thread.buffer;
+    const std::uint64_t n = b.head.load(std::memory_order_relaxed);
+    trace_event&        e = b.events[n%trace_capacity];
+    e.seq.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    e.name.store(name, std::memory_order_relaxed);
+    e.arg.store(arg, std::memory_order_relaxed);
+    e.start.store(start, std::memory_order_relaxed);
+    e.duration.store(stop-start, std::memory_order_relaxed);
+    e.tid.store(this_thread.tid, std::memory_order_relaxed);
+    e.seq.store(n+1, std::memory_order_release);
+    b.head.store(n+1, std::memory_order_release);
+}
+
+PARAMETERS_INLINE void Parameters::dump_trace(std::ostream& out) {
+    /* times are in microseconds, with 3 decimals */
+    auto micros = [] (const std::uint64_t ns) {
+        std::string frac = std::to_string(ns%1000);
+        return std::to_string(ns/1000) + "." + std::string(3-frac.size(), '0') + frac;
+    };
+    trace_registry& registry = tracer();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    std::string json = "{\"traceEvents\":[";
+    bool        first = true;
+    for(const std::unique_ptr<trace_buffer>& b: registry.buffers) {
+        const std::uint64_t head = b->head.load(std::memory_order_acquire);
+        for(std::uint64_t n=(head>trace_capacity ? head-trace_capacity : 0) ; n<head ; n++) {
+            const trace_event& e   = b->events[n%trace_capacity];
+            const std::uint64_t seq = e.seq.load(std::memory_order_acquire);
+            if(seq!=n+1) continue;
+            const char* const   name     = e.name.load(std::memory_order_relaxed);
+            const long long     arg      = e.arg.load(std::memory_order_relaxed);
+            const std::uint64_t start    = e.start.load(std::memory_order_relaxed);
+            const std::uint64_t duration = e.duration.load(std::memory_order_relaxed);
+            const std::uint32_t tid      = e.tid.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if(e.seq.load(std::memory_order_relaxed)!=seq) continue;
+            json += first ? "\n" : ",\n";
+            json += "{\"name\":\"" + std::string(name) + "\",\"cat\":\"help80\",\"ph\":\"X\",\"ts\":" + micros(start)
+                  + ",\"dur\":" + micros(duration) + ",\"pid\":1,\"tid\":" + std::to_string(tid);
+            if(arg>=0) json += ",\"args\":{\"value\":" + std::to_string(arg) + "}";
+            json += "}";
+            first = false;
+        }
+    }
+    json += "\n],\"displayTimeUnit\":\"ns\"}\n";
+    out << json;
+}
+
+#endif
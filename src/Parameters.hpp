@@ -26,14 +26,17 @@ FILE
     The classes defined in this file can be used for parameters parsing and display, while
     making sure the help menu looks nice on terminals.
 
-    This file defines classes Parameters, ParamHolder and Param. Param is a template function
-    that inherits from ParamHolder. Parameters owns a std::vector of ParamHolder, and has access
-    to the derived object Param through dynamic_cast.
+    This file defines classes Parameters, ParamHolder, Param and ChoiceParam. Param is a template
+    function that inherits from ParamHolder. Parameters owns a std::vector of ParamHolder, and has
+    access to the derived object Param through param_cast, that compares a tag of the type of the
+    values instead of using RTTI. ChoiceParam is a Param<std::string> that also stores its choices,
+    indexed by name in a hash table.
     
-    To store parameters of multiple types, the std::string version of types is available with
-    typeid(T).name(). This type is stored in ParamHolder. When arguments are parsed, each type is
-    tried, and the right function is called for the right type (among stoi, stod, stold, and
-    nothing for std::string parameters).
+    To store parameters of multiple types, Param<T> reads and prints its values with
+    ParseTraits<T>, and ParamHolder gives access to them through virtual functions. When
+    arguments are parsed, each parameter parses its values in place from the command line, with
+    no lookup of its type. ParseTraits is specialized for the integer and floating point types,
+    std::string and bool, and can be specialized for any other type.
     
     
                           ---------------                 ----------------
@@ -45,10 +48,19 @@ FILE
                          -------------| Template |
                          |     Param  --+---------
                          ----------------
+                                 ^
+                                 |
+                         ---------------
+                         | ChoiceParam |
+                         ---------------
  
                          
-    ParamHolder and Param are private nested classes inside class Parameters. Also, Parameters
-    defines the following exception classes:
+    ParamHolder, Param and ChoiceParam are private nested classes inside class Parameters. To keep
+    large schemas small, a parameter's name is the key of the lookup table, its description is a
+    view on a literal() or on a string interned in the object's StringPool, and its values
+    share the default values until the command line writes to them.
+    
+    Parameters also defines the following exception classes:
         - ValueOutOfRangeException: thrown if the value given is not in the range of the built-in
                                     type
         - NotEnoughValuesException: when cmd line doesn't have as many args as required
@@ -56,15 +68,33 @@ FILE
         - IntegerExpectedException: when an integer value is expected but not given
         - UndefinedValueException: when trying to access n-th value of a parameter that doesn't
                                    exist
-        - UnsupportedParameterTypeException: when the developer tries to create a parameter of
-                                             unsupported type
+        - InvalidValueException: when a value cannot be parsed by ParseTraits<T> of a type
+                                 other than the numeric types
+        - UnsupportedParameterTypeException: when the type of an entry of define_schema is not
+                                             a built-in type
         - DuplicateParameterException: when the developer tries to create a parameter with an
                                        existing name
         - UnknownParameterException: when there is an unknown parameter in the command line
         - UndefinedParameterException: when the developer tries to retrieve value for a parameter
                                        that doesn't exist
-        - DynamicCastFailedException: when a dynamic_cast returns a null pointer. This happens in
-                                      a call to num_val with wrong template type for instance
+        - DynamicCastFailedException: when the template type doesn't match the type of the values
+                                      of the parameter, in a call to num_val for instance
+        - InvalidSnapshotException: when a snapshot is truncated or corrupt, or was taken with
+                                    another schema
+        - NothingPublishedException: when a ReadGuard is taken before the first publish
+        - UnknownSubcommandException: when the command line calls a subcommand that doesn't exist
+        - DuplicateOccurrenceException: when a parameter set to occurrence_error is given twice
+        - ValueOutOfBoundsException: when a value is outside of the range set with set_range
+        - MissingRequiredParameterException: when a parameter is given without one it requires
+        - ConflictingParametersException: when two conflicting parameters are given
+        - GroupConstraintException: when too many or too few parameters of a group are given
+        - UnbalancedQuoteException: when a quote is not closed in a command given to parse_params
+        - UnitExpectedException: when the unit of a value is unknown, or the value is not a whole
+                                 number of the base unit
+        - InvalidDescriptorException: when an entry given to define_schema lacks a field it needs,
+                                      or has a control char in a name
+        - InvalidSchemaException: when a line of a schema file cannot be read as an entry
+        - UnreadableSchemaException: when a schema file cannot be opened
     
  
     How to build the menu:
@@ -74,11 +104,55 @@ FILE
  
         To build the menu, use the functions:
             - define_param :        to define a parameter with no value
-            - define_num_str_param: to define a numeric or std::string parameter
+            - define_num_str_param: to define a numeric or std::string parameter, or one of
+                                    any type with ParseTraits
             - define_choice_param:  to define a multiple choice parameter
+            - define_unit_param:    to define an integer parameter typed with a unit, like 4GiB
  
         You can add structure by adding subsections with function insert_subsection.
-        When the menu is ready, you can print it with print_help().
+        
+        Large generated schemas are defined at once with define_schema, from an array of
+        descriptors, or with load_schema, from a file with one tab-separated entry per line.
+        The names are sorted once to find the duplicates, the new keys are inserted into the
+        map of parameters with hints, and all the parameters are built in a single allocation.
+        The strings of the descriptors are pointed to, not copied: a loaded file is kept and
+        split in place.
+        
+        When the menu is ready, you can print it with print_help(). Styles are only used when
+        stdout is a terminal that supports them. To print the menu somewhere else, give a
+        PlainRenderer, AnsiRenderer or HtmlRenderer to print_help. A renderer writes to a
+        std::string, a std::ostream or a callback. The layout only writes one byte markers for
+        the styles, and the renderer replaces them, so styles never change the layout. With
+        set_layout_jobs, large menus are laid out on several threads, each in its own buffer, then
+        written in order.
+        search_help prints only the params that match a query, from an inverted index of the
+        words of the menu: sorted distinct words, each with the params, fields and choices it
+        appears in. The index is built at the first search, or read from a file written by
+        write_search_index, after a hash of the params and their texts is checked.
+ 
+        Constraints between parameters are declared with set_range, add_requires,
+        add_conflicts, add_one_of_group and add_at_most_group. They are compiled into bit masks
+        over the parameters' ids the first time they are checked, at the end of parse_params.
+        Checking a rule then takes a few AND and compare operations per 64 parameters.
+ 
+        Sizes, durations and counts are defined with define_unit_param. The values are stored in
+        the base unit of the UNIT given, like bytes or milliseconds, in a Param<T> of an integer
+        type. The number and its unit are read in one pass, with the units looked up in constexpr
+        tables, and scaled without overflowing 64 bits. Default values are printed in the largest
+        unit that divides them.
+ 
+        Programs with subcommands (git-style) register them with define_subcommand, along with
+        a function that defines the subcommand's parameters. The parameters defined directly on
+        the object are global. parse_params stops at the first subcommand name, creates a new
+        Parameters object for it, calls its function, and parses the rest of the command line
+        with it. Only the invoked subcommand's parameters are ever defined. Global parameters
+        are still accepted after the subcommand name.
+ 
+        The args that are not parameters fill the slots declared with define_positional, in
+        order, each slot taking between min and max args. A slot is a Param<T> whose args are
+        its accumulated occurrences, converted like any value. Everything after "--" is left
+        to the caller: passthrough returns a span into the parsed argv, followed by a null
+        pointer like argv, so it can be given to execv without being copied.
         
  
     How to use the parameters:
@@ -86,9 +160,72 @@ FILE
         First, call parse_params to analyse the command line arguments. Then,
         use the functions:
             - is_spec : to know if a simple parameter is specified
+            - occurrences : to know how many times a parameter is specified
             - num_val : to get a numeric value
             - str_val : to get a std::string value
             - cho_val : to get a multiple choice value
+            - cho_index : to get the index of a multiple choice value, or cho_enum to get it
+                          converted to an enum whose values follow the order of the choices
+        and has_subcommand, subcommand_name and subcommand to retrieve the invoked subcommand.
+        The args of a positional slot are given by num_vals or str_vals, and the args after "--"
+        by passthrough.
+ 
+        parse_params can also be given a command as a single string, which is split like a
+        shell would, or a range of args. Values are reset to their defaults first, so the same
+        object can parse a stream of commands. The command is copied into a buffer that keeps
+        its capacity, and split in place there.
+ 
+        When a parameter is given several times, the last occurrence wins by default. Use
+        set_occurrence_policy to keep the first one, to throw, or to accumulate all of them.
+        Accumulated values are appended to a single buffer, reserved once for all the
+        occurrences on the command line, and read with num_vals or str_vals.
+ 
+        The parsed state can be saved with snapshot(), and restored in another process that
+        defined the same parameters with attach_snapshot(), instead of calling parse_params.
+        The snapshot is a flat binary blob that can be memory-mapped or put in shared memory:
+            - header:    magic "H80S", version (uint32), schema fingerprint (uint64),
+                         nb of parameters (uint32)
+            - then for each parameter, in definition order: is_defined (uint8), nb of
+                         occurrences (uint32), the values, the nb of accumulated values (uint32)
+                         and the accumulated values. Numeric values are stored with their native
+                         representation, bools as one byte, 0 or 1, strings as a length (uint32)
+                         followed by the characters.
+            - last, the name of the invoked subcommand and its own snapshot, as strings, both
+                         empty if there is no subcommand.
+        The fingerprint hashes the names, types, nb of values and choices of all parameters.
+ 
+ 
+    Shell completion:
+ 
+        Call complete() after the parameters are defined and before parse_params. If the first
+        argument is "--__complete", the remaining arguments are the words typed so far and the
+        candidates for the last one are printed, one per line. "--__complete_script <shell>"
+        prints a bash, zsh or fish script that calls the program this way. After a subcommand,
+        the subcommand is defined and answers with its params and those of the main command.
+        To answer without defining the parameters at all, write the schema once with
+        write_completion_index and call the static function complete_from_index first thing in
+        main: the index file is memory-mapped and queried directly. Its entries, parameters and
+        subcommands, are sorted by name behind a table of their offsets, so each word is found
+        by binary search. The index only holds the main command, not the params of subcommands.
+ 
+ 
+    Build profiles:
+ 
+        Define PARAMETERS_HEADER_ONLY before including this file to use it without compiling
+        Parameters.cpp: the header includes it, and its functions are declared inline. Static
+        data is kept in local statics of inline functions, so that there is one copy per program,
+        and constants are enumerators, which need no definition. No RTTI is needed, param_cast
+        checks the type of the values with a tag. Without exceptions (-fno-exceptions), an error
+        in a command line, a schema or a snapshot is recorded and the call returns early:
+        last_error() gives its code and last_error_message() its message. A schema or a snapshot
+        in error defines or changes nothing, and a reparse in error publishes nothing. Other
+        errors are bugs of the program: their message is given to the handler set with
+        set_error_handler, and the program aborts if the handler returns.
+ 
+        Define PARAMETERS_TRACE to 1 to record the time spent defining, parsing, converting and
+        validating values, and laying out and writing the help menu. Each thread appends events
+        to its own ring buffer, with no lock, and dump_trace writes the events of all the rings
+        as Chrome trace-event JSON. Without it, the trace points are not compiled.
  
 ************************************************************************************************
 
@@ -113,9 +250,65 @@ FILE
     #define PLATFORM PLATFORM_UNIX
 #endif
 
+/*
+    build profile: define PARAMETERS_HEADER_ONLY before including this file to compile the whole
+    library in the including files, without Parameters.cpp. Exceptions are used if the compiler
+    has them. Otherwise an error in the input is recorded and the function returns, its callers
+    return too when PARAMETERS_FAILED, and other errors are given to the handler set with
+    set_error_handler
+*/
+#ifndef PARAMETERS_EXCEPTIONS
+    #if defined(__cpp_exceptions) || defined(__EXCEPTIONS) || defined(_CPPUNWIND)
+        #define PARAMETERS_EXCEPTIONS 1
+    #else
+        #define PARAMETERS_EXCEPTIONS 0
+    #endif
+#endif
+#if PARAMETERS_EXCEPTIONS
+    #define PARAMETERS_THROW(...)      throw __VA_ARGS__
+    #define PARAMETERS_FAIL(code, ...) throw __VA_ARGS__
+    #define PARAMETERS_FAILED          false
+    #define PARAMETERS_TRY             try
+    #define PARAMETERS_CATCH_ALL       catch(...)
+    #define PARAMETERS_RETHROW         throw
+#else
+    #define PARAMETERS_THROW(...)      Parameters::fail(__VA_ARGS__)
+    #define PARAMETERS_FAIL(code, ...) return Parameters::record_error(code, __VA_ARGS__)
+    #define PARAMETERS_FAILED          (Parameters::current_error().code!=Parameters::error_none)
+    #define PARAMETERS_TRY             if(true)
+    #define PARAMETERS_CATCH_ALL       else
+    #define PARAMETERS_RETHROW         std::abort()
+#endif
+#ifdef PARAMETERS_HEADER_ONLY
+    #define PARAMETERS_INLINE inline
+#else
+    #define PARAMETERS_INLINE
+#endif
+
+/*
+    trace points: define PARAMETERS_TRACE to 1, in all the files including Parameters.cpp, to
+    record the time spent in the main phases. Otherwise the trace points are not compiled
+*/
+#ifndef PARAMETERS_TRACE
+    #define PARAMETERS_TRACE 0
+#endif
+#ifndef PARAMETERS_TRACE_CAPACITY
+    #define PARAMETERS_TRACE_CAPACITY 4096
+#endif
+#define PARAMETERS_TRACE_CONCAT(a, b) a##b
+#define PARAMETERS_TRACE_VAR(line)    PARAMETERS_TRACE_CONCAT(trace_scope_, line)
+#if PARAMETERS_TRACE
+    #define PARAMETERS_TRACE_SCOPE(name, arg) const Parameters::TraceScope PARAMETERS_TRACE_VAR(__LINE__)(name, static_cast<long long>(arg))
+#else
+    #define PARAMETERS_TRACE_SCOPE(name, arg)
+#endif
+
 /* headers for terminal width */
 #if PLATFORM == PLATFORM_MAC || PLATFORM == PLATFORM_UNIX
+    #include <fcntl.h>
     #include <sys/ioctl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
     #include <stdio.h>
     #include <unistd.h>
 #elif PLATFORM == PLATFORM_WINDOWS
@@ -123,12 +316,31 @@ FILE
 #endif
 
 /* other headers */
+#include <algorithm>
+#include <atomic>
+#include <bitset>
+#include <cctype>
+#include <chrono>
+#include <cerrno>
+#include <cstddef>
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <fstream>
 #include <iostream>
+#include <iterator>
+#include <functional>
 #include <limits>
 #include <map>
-#include <set>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
 #include <sstream>
-#include <typeinfo>
+#include <type_traits>
+#include <unordered_map>
 #include <vector>
 
 class Parameters {
@@ -138,9 +350,185 @@ class Parameters {
     public:
     
         typedef std::vector<std::pair<std::string, std::string>> vec_choices;
+        typedef std::function<void(Parameters&)>                 subcommand_factory;
     
         enum LANG {lang_fr, lang_us};
     
+        enum SHELL {shell_bash, shell_zsh, shell_fish};
+    
+        enum OCCURRENCE {occurrence_last, occurrence_first, occurrence_error, occurrence_accumulate};
+    
+        enum UNIT {unit_bytes, unit_nanoseconds, unit_microseconds, unit_milliseconds, unit_seconds, unit_count};
+    
+        enum PARSE {parse_ok, parse_invalid, parse_out_of_range};
+    
+        template<typename T>
+        class Span {                                                                       // read-only view on contiguous values
+            public:
+                Span(): first(nullptr), count(0) {}
+                Span(const T* const p_first, const std::size_t p_count): first(p_first), count(p_count) {}
+                const T*          begin()                        const { return first; }
+                const T*          end()                          const { return first + count; }
+                const T*          data()                         const { return first; }
+                const std::size_t size()                         const { return count; }
+                const bool        empty()                        const { return count==0; }
+                const T&          operator[](const std::size_t i) const { return first[i]; }
+            private:
+                const T*    first;
+                std::size_t count;
+        };
+    
+        class Text {                                                                       // description: copied or moved into a pool, only
+            public:                                                                        // pointed to if made with Parameters::literal
+                template<std::size_t N>
+                Text(const char (&array)[N]): literal(nullptr), literal_size(0), owned(array, length(array, N)) {}
+                template<typename C, typename=typename std::enable_if<std::is_same<C, const char*>::value || std::is_same<C, char*>::value>::type>
+                Text(const C& str): literal(nullptr), literal_size(0), owned(str) {}
+                Text(const std::string& str): literal(nullptr), literal_size(0), owned(str) {}
+                Text(std::string&& str):      literal(nullptr), literal_size(0), owned(std::move(str)) {}
+            private:
+                friend class Parameters;
+                Text(const char* const str, const std::size_t size): literal(str), literal_size(size) {}
+                static std::size_t length(const char* const str, const std::size_t max) { // chars before the first NUL, at most max
+                    const void* const nul = std::memchr(str, 0, max);
+                    return nul ? static_cast<std::size_t>(static_cast<const char*>(nul)-str) : max;
+                }
+                const char*       literal;                                                 // string literal, or nullptr
+                const std::size_t literal_size;                                            // nb of chars of the literal
+                std::string       owned;                                                   // any other string
+        };
+    
+        /*
+            How values of type T are read and printed. Specialize it for your own types, with:
+                static const PARSE parse(const char* first, const char* last, T& value);
+                static const std::string format(const T& value);
+                static const char* name();
+            The chars to parse are always followed by a NUL, so C functions like strtol can be
+            used. The types of the standard library are handled below.
+        */
+        template<typename T, typename=void>
+        struct ParseTraits;
+    
+        template<typename T>
+        struct ParseTraits<T, typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, bool>::value>::type> {
+            /* base 10, like std::stoi: leading spaces are skipped and the chars after the number are ignored */
+            static const PARSE parse(const char* const first, const char* const, T& value) {
+                char* stop = nullptr;
+                errno = 0;
+                if(std::is_signed<T>::value) {
+                    const long long n = std::strtoll(first, &stop, 10);
+                    if(stop==first) return parse_invalid;
+                    if(errno==ERANGE || n<static_cast<long long>(std::numeric_limits<T>::min()) || n>static_cast<long long>(std::numeric_limits<T>::max())) return parse_out_of_range;
+                    value = static_cast<T>(n);
+                }
+                else {
+                    const unsigned long long n = std::strtoull(first, &stop, 10);
+                    if(stop==first) return parse_invalid;
+                    if(errno==ERANGE || n>static_cast<unsigned long long>(std::numeric_limits<T>::max())) return parse_out_of_range;
+                    value = static_cast<T>(n);
+                }
+                return parse_ok;
+            }
+            static const std::string format(const T& value) { return std::to_string(value); }
+            static const char* name() {
+                return std::is_same<T, short int             >::value ? "short int"
+                     : std::is_same<T, unsigned short int    >::value ? "unsigned short int"
+                     : std::is_same<T, int                   >::value ? "int"
+                     : std::is_same<T, unsigned int          >::value ? "unsigned int"
+                     : std::is_same<T, long int              >::value ? "long int"
+                     : std::is_same<T, unsigned long int     >::value ? "unsigned long int"
+                     : std::is_same<T, long long int         >::value ? "long long int"
+                     : std::is_same<T, unsigned long long int>::value ? "unsigned long long int"
+                     : std::is_signed<T>::value                       ? "signed integer" : "unsigned integer";
+            }
+        };
+    
+        template<typename T>
+        struct ParseTraits<T, typename std::enable_if<std::is_floating_point<T>::value>::type> {
+            static const PARSE parse(const char* const first, const char* const, T& value) {
+                char* stop = nullptr;
+                errno = 0;
+                value = to_float(first, &stop, value);
+                if(stop==first)   return parse_invalid;
+                if(errno==ERANGE) return parse_out_of_range;
+                return parse_ok;
+            }
+            static const std::string format(const T& value) { std::ostringstream oss; oss << value; return oss.str(); }
+            static const char* name() {
+                return std::is_same<T, float>::value ? "float" : std::is_same<T, double>::value ? "double" : "long double";
+            }
+            private:
+                static float       to_float(const char* const str, char** stop, float)       { return std::strtof(str, stop); }
+                static double      to_float(const char* const str, char** stop, double)      { return std::strtod(str, stop); }
+                static long double to_float(const char* const str, char** stop, long double) { return std::strtold(str, stop); }
+        };
+    
+        template<typename T>
+        struct ParseTraits<T, typename std::enable_if<std::is_same<T, std::string>::value>::type> {
+            static const PARSE       parse(const char* const first, const char* const last, T& value) { value.assign(first, last); return parse_ok; }
+            static const std::string format(const T& value) { return "\"" + value + "\""; }
+            static const char*       name() { return "std::string"; }
+        };
+    
+        template<typename T>
+        struct ParseTraits<T, typename std::enable_if<std::is_same<T, bool>::value>::type> {
+            static const PARSE parse(const char* const first, const char* const last, T& value) {
+                const std::string str(first, last);
+                if(str=="true"  || str=="1") { value = true;  return parse_ok; }
+                if(str=="false" || str=="0") { value = false; return parse_ok; }
+                return parse_invalid;
+            }
+            static const std::string format(const T& value) { return value ? "true" : "false"; }
+            static const char*       name() { return "bool"; }
+        };
+    
+        class Renderer {                                                                   // turns the help menu into text for a sink
+            public:
+                typedef std::function<void(const char* const, const std::size_t)> sink;
+                static const char bold_on       = '\x01';                                  // markers written by the layout, they take
+                static const char bold_off      = '\x02';                                  // no room in the menu and are replaced by
+                static const char underline_on  = '\x03';                                  // the renderer's styles. Each off marker
+                static const char underline_off = '\x04';                                  // follows its on marker
+                explicit Renderer(const sink&);                                            // sends the text to the callback
+                explicit Renderer(std::string&);                                           // appends the text to the string
+                explicit Renderer(std::ostream&);                                          // writes the text to the stream
+                virtual ~Renderer() {}
+                void                      begin();                                         // writes the document header
+                void                      write(const std::string&);                       // replaces markers and escapes, then writes
+                void                      end();                                           // writes the document footer
+            protected:
+                virtual const char*       header()                       const { return ""; }
+                virtual const char*       footer()                       const { return ""; }
+                virtual const char*       style(const char)              const = 0;        // text replacing a marker
+                virtual const char*       escape(const char)             const { return nullptr; } // text replacing a char, if any
+            private:
+                const sink out;
+        };
+    
+        class PlainRenderer: public Renderer {                                             // no styles, for files and pipes
+            public:
+                using Renderer::Renderer;
+            protected:
+                const char*               style(const char)              const { return ""; }
+        };
+    
+        class AnsiRenderer: public Renderer {                                              // escape codes, for terminals
+            public:
+                using Renderer::Renderer;
+            protected:
+                const char*               style(const char)              const;
+        };
+    
+        class HtmlRenderer: public Renderer {                                              // <pre> block, for web pages and Markdown
+            public:
+                using Renderer::Renderer;
+            protected:
+                const char*               header()                       const { return "<pre>\n"; }
+                const char*               footer()                       const { return "</pre>\n"; }
+                const char*               style(const char)              const;
+                const char*               escape(const char)             const;
+        };
+    
         struct config {
             const int min_terminal_width;                                                  // min width of terminal
             const int max_terminal_width;                                                  // max width of terminal
@@ -161,41 +549,305 @@ class Parameters {
         template<typename T>
         const T                   num_val(const std::string&, const int=1)     const;      // return n-th value for parameter. nb starts at 1
         const std::string         str_val(const std::string&, const int=1)     const;      // return n-th value for parameter. nb starts at 1
-        const std::string         cho_val(const std::string&)                  const;      // returns choice value
+        const std::string&        cho_val(const std::string&)                  const;      // returns choice value
+        const std::size_t         cho_index(const std::string&)                const;      // returns index of choice value
+        template<typename E>
+        const E                   cho_enum(const std::string&)                 const;      // returns index of choice value as an enum
         const bool                is_spec(const std::string&)                  const;      // tells if parameters is defined
-        void                      parse_params();                                          // reads cmd line and store args
+        const std::size_t         occurrences(const std::string&)              const;      // nb of times the parameter was given
+        template<typename T>
+        const Span<T>             num_vals(const std::string&)                 const;      // values of all occurrences, when accumulated
+        const Span<std::string>   str_vals(const std::string&)                 const;      // values of all occurrences, when accumulated
+        void                      parse_params();                                          // reads cmd line and store args, from default values
+        void                      parse_params(const std::string&);                        // splits a command like a shell, then parses it
+        template<typename It>
+        void                      parse_params(It, It);                                    // parses args with data() and size(), like std::string
+        const Span<const char*>   passthrough()                                const;      // args after "--", into argv, followed by a null pointer
+        const bool                has_subcommand()                             const;      // tells if a subcommand was invoked
+        const std::string&        subcommand_name()                            const;      // name of the invoked subcommand
+        Parameters&               subcommand()                                 const;      // parameters of the invoked subcommand
+        const std::string         snapshot()                                   const;      // serializes parsed values
+        void                      attach_snapshot(const char* const, const std::size_t);   // restores values from a snapshot
+    
+        /* concurrent readers */
+        class Snapshot;
+        class ReadGuard;
+        void                      publish();                                               // makes current values visible to readers
+        void                      reparse(const int, char const* const* const);            // parses new args from defaults, then publishes
     
         /* help menu */
         void                      insert_subsection(const std::string&);                   // prints subsection when printing help menu
-        void                      print_help(const bool=true, const bool=true) const;      // print help menu
+        void                      print_help(const bool=true, const bool=true) const;      // print help menu on stdout
+        void                      print_help(Renderer&, const bool=true,
+                                             const bool=true)                  const;      // print help menu with the renderer
+        const std::size_t         search_help(const std::string&)              const;      // prints the params matching all the words, best first
+        const std::size_t         search_help(Renderer&, const std::string&)   const;      // same, with the renderer
+        void                      write_search_index(const std::string&)       const;      // saves the index used by search_help
+        const bool                read_search_index(const std::string&)        const;      // loads it, false if missing or for other params
+        static const bool         terminal_supports_styles();                              // tells if stdout is a terminal with styles
         void                      set_program_description(const std::string&);             // sets program description
         void                      set_usage(const std::string&);                           // sets usage
+        void                      set_layout_jobs(const std::size_t,
+                                                  const std::size_t=512);                  // threads laying out the menu, 0 for one per core, and min params per thread
+    
+        /* shell completion */
+        const bool                complete()                                   const;      // answers a completion query, true if argv was one
+        void                      print_completion_script(const SHELL)         const;      // prints completion script for the given shell
+        void                      write_completion_index(const std::string&)   const;      // writes the schema index used by complete_from_index
+        static const bool         complete_from_index(const int, char const* const* const,
+                                                      const std::string&);                 // answers a completion query from an index file
+    
+        template<typename T>  // in the order: add a parameter with values, with choices, with no values. Defaults and choices are moved in
+        void define_num_str_param(const std::string&, const std::vector<std::string>&, std::vector<T>, Text, const bool=false);
+        void define_choice_param(const std::string&, const std::string&, const std::string&, vec_choices, Text, const bool=false);
+        void define_param(const std::string&, Text);
+        template<std::size_t N>  // a description that is only pointed to, not copied: it must outlive the object
+        static Text literal(const char (&)[N]);
+    
+        template<typename T>  // same, values are also written to the given variable
+        void define_num_str_param(const std::string&, const std::string&, const T&, Text, T&, const bool=false);
+        template<typename T>
+        void define_num_str_param(const std::string&, const std::vector<std::string>&, std::vector<T>, Text, std::vector<T>&, const bool=false);
+        template<typename E>  // E is an enum or an integer type, the position of the choice is stored
+        typename std::enable_if<std::is_enum<E>::value || (std::is_integral<E>::value && !std::is_same<E, bool>::value)>::type
+             define_choice_param(const std::string&, const std::string&, const std::string&, vec_choices, Text, E&, const bool=false);
+        void define_choice_param(const std::string&, const std::string&, const std::string&, vec_choices, Text, std::string&, const bool=false);
+        void define_param(const std::string&, Text, bool&);
+        void define_subcommand(const std::string&, const std::string&, subcommand_factory);
+    
+        /* positional arguments */
+        enum : std::size_t {unbounded = std::numeric_limits<std::size_t>::max()};          // max nb of args of a slot without limit
+        template<typename T>  // takes between min and max of the args that are not parameters, in definition order
+        void define_positional(const std::string&, const std::string&, const std::size_t, const std::size_t, Text);
+    
+        /* values with units */
+        template<typename T>  // T is an integer type, values are stored in the base unit of the UNIT, like bytes or milliseconds
+        void define_unit_param(const std::string&, const std::vector<std::string>&, const UNIT, std::vector<T>, Text, const bool=false);
+        template<typename T>
+        void define_unit_param(const std::string&, const std::string&, const UNIT, const T&, Text, T&, const bool=false);
+    
+        /* bulk definitions */
+        enum DESCRIPTOR {descriptor_subsection, descriptor_param, descriptor_value, descriptor_choice};
+        struct descriptor {                                                                // one entry of a schema, its strings must outlive the object
+            DESCRIPTOR                     kind;                                           // what the entry defines
+            const char*                    name;                                           // param name without "--", or subsection title
+            const char*                    type;                                           // type of the values, as named by ParseTraits, like "int"
+            const char*                    values_names;                                   // names of the values, separated by '|'
+            const char*                    defaults;                                       // default values or default choice, separated by '|'
+            const char*                    choices;                                        // "choice=description" of each choice, separated by '|'
+            bool                           display_default_value;                          // if default value has to be displayed in help menu
+            const char*                    description;                                    // long description paragraph
+        };
+        void define_schema(const descriptor* const, const std::size_t);                    // defines all the entries at once
+        void load_schema(const std::string&);                                              // defines the entries of a schema file
+    
+        /* repeated parameters */
+        void set_occurrence_policy(const std::string&, const OCCURRENCE);                  // what to do when a param is given again
+    
+        /* constraints */
+        template<typename T>
+        void set_range(const std::string&, const T&, const T&);                            // values must be in [min, max]
+        void add_requires(const std::string&, const std::vector<std::string>&);            // if param is given, all others must be
+        void add_conflicts(const std::string&, const std::vector<std::string>&);           // if param is given, no other can be
+        void add_one_of_group(const std::vector<std::string>&);                            // exactly one param of group must be given
+        void add_at_most_group(const std::size_t, const std::vector<std::string>&);        // at most n params of group can be given
+    
+        /* errors, when built without exceptions */
+        enum ERROR_CODE {error_none, error_unknown_parameter, error_unknown_subcommand, error_unknown_choice,
+                         error_not_enough_values, error_integer_expected, error_decimal_expected, error_invalid_value,
+                         error_unit_expected, error_value_out_of_range, error_value_out_of_bounds, error_duplicate_occurrence,
+                         error_missing_required, error_conflicting_parameters, error_group_constraint, error_unbalanced_quote,
+                         error_invalid_snapshot, error_invalid_descriptor, error_unsupported_type, error_duplicate_parameter,
+                         error_invalid_schema, error_unreadable_schema};
+        typedef void (*error_handler)(const char* const);                                  // receives the message of the error
+        static void set_error_handler(const error_handler);                                // called for an error of the program, then abort
+        static const ERROR_CODE   last_error();                                            // error of the last parse, load or attach in the thread
+        static const std::string  last_error_message();                                    // message of that error, empty if none
     
-        template<typename T>  // in the order: add a parameter with values, with choices, with no values
-        void define_num_str_param(const std::string&, const std::vector<std::string>&, const std::vector<T>&, const std::string&, const bool=false);
-        void define_choice_param(const std::string&, const std::string&, const std::string&, vec_choices, const std::string&, const bool=false);
-        void define_param(const std::string&, const std::string&);
+        /* tracing, with PARAMETERS_TRACE set to 1 */
+        static void dump_trace(std::ostream&);                                             // writes the events kept for all threads, as Chrome trace JSON
     
     
     private:
     
-        typedef std::map<std::string, ParamHolder* const> map_params;
-        typedef std::map<std::string, vec_choices>        map_choices;
-        typedef std::map<size_t, std::string>             map_order;
+        class StringPool {                                                                 // stores each distinct string once, under a 32-bit id
+            public:
+                const std::uint32_t intern(std::string&&);                                 // id of the string, stored if new
+                const std::string&  at(const std::uint32_t id) const { return strings[id]; }
+            private:
+                std::deque<std::string>                             strings;               // strings by id, never move once stored
+                std::unordered_multimap<std::size_t, std::uint32_t> ids;                   // ids by hash of their string
+        };
+    
+        typedef std::map<std::string, ParamHolder*>       map_params;
+        typedef std::vector<ParamHolder*>                 vec_order;
+        typedef std::map<std::string, std::pair<std::string, subcommand_factory>> map_subcommands;
+        typedef std::vector<std::uint64_t>                mask;
+    
+        enum CONSTRAINT {constraint_requires, constraint_conflicts, constraint_one_of, constraint_at_most};
+    
+        struct constraint {
+            CONSTRAINT                     kind;                                           // type of rule
+            std::string                    subject;                                        // param the rule applies to, for requires and conflicts
+            std::vector<std::string>       others;                                         // required or conflicting params, or group
+            std::size_t                    n;                                              // max nb of params of group for at_most
+            std::string                    label;                                          // printed before the rule in the help menu
+            std::string                    text;                                           // others as $p(name), printed after the label
+        };
+    
+        struct positional {
+            ParamHolder*                   param;                                          // param that stores the args, in its accumulated values
+            std::size_t                    min;                                            // nb of args required
+            std::size_t                    max;                                            // nb of args accepted, or unbounded
+        };
     
+        struct compiled_constraint {
+            std::size_t                    subject;                                        // id of subject
+            mask                           others;                                         // bit set for each param of others
+        };
+    
+        Parameters(const int, char const* const* const, Parameters* const);            // subcommand, argv starts at its name
         Parameters(const Parameters&);
         Parameters& operator=(const Parameters&);
     
         /* display funcs */
         static const int          get_terminal_width();                                    // returns current's terminal width
-        static const std::string  bold(const std::string&);                                // returns the bold version of str
-        static const std::string  underline(const std::string&);                           // returns the underlined version of str
-        template<typename T> void pr_def(ParamHolder* const, const bool=false) const;      // prints default value
-        void                      print_description()                          const;      // print program description
-        void                      print_usage()                                const;      // print usage
-        void                      print_parameters()                           const;      // print list of parameters
-        void                      print_text(const std::string&, const bool, const int,
-                                       const std::string&, ParamHolder* const) const;      // printing method
+        static const std::string  bold(const std::string&);                                // returns str between bold markers
+        static const std::string  underline(const std::string&);                           // returns str between underline markers
+        static const int          visible_length(const std::string&);                      // nb of chars of str, without markers
+        static const Span<char>   view(const std::string&);                                // view on the chars of str
+        void                      pr_def(ParamHolder* const, Renderer&)        const;      // prints default values
+        void                      print_description(Renderer&)                 const;      // print program description
+        void                      print_usage(Renderer&)                       const;      // print usage
+        class LayoutRenderer;                                                              // keeps the markers, for a thread laying out params
+        void                      print_parameters(Renderer&)                  const;      // print list of parameters
+        void                      print_parameters(Renderer&, const std::size_t,
+                                                   const std::size_t)          const;      // print params [first, last)
+        void                      print_param(ParamHolder* const, Renderer&,
+                                              const std::vector<std::size_t>&) const;      // print param, only the given choices if any
+        void                      print_subcommands(Renderer&)                 const;      // print list of subcommands
+        void                      print_constraints(ParamHolder* const,
+                                                    Renderer&)                 const;      // print range and rules of param
+        void                      print_rule(const std::string&, const std::string&,
+                                             ParamHolder* const, Renderer&)    const;      // print label, then text after it or under it
+        void                      print_text(const Span<char>&, const bool, const int,
+                                       const std::string&, ParamHolder* const,
+                                       Renderer&, const bool=false)            const;      // printing method, markers kept if styled
+    
+        /* definitions */
+        template<typename P, typename... Args>
+        P* const                  add_param(const std::string&, Args&&...);                // checks name, creates and stores a param
+        const Span<char>          keep(Text&&);                                            // view on the text, pooled if not a literal
+        std::vector<std::uint32_t> intern_all(const std::vector<std::string>&);            // ids in pool of the strings
+        std::vector<std::uint32_t> intern_items(const char*);                               // ids in pool of the items of a '|' list
+        static const std::size_t  count_items(const char*);                                // nb of items of a '|' list, none if the list is null
+        static const bool         has_control(const char*, const char* const);             // tells if chars have a control char, left out of the menu
+        static const std::uint64_t prefix_word(const char*);                               // first 8 chars, big-endian and NUL padded to compare like str
+        static void               unescape(char*);                                         // replaces \n, \t and \\ in place
+        struct value_kind {                                                                // how define_schema builds a Param<T>
+            const char*                    type;                                           // name of T, as given by ParseTraits
+            std::size_t                    size;                                           // room taken by the Param<T> in a batch
+            ParamHolder*                 (*build)(void* const, const std::string&, const Span<char>&,
+                                                  std::vector<std::uint32_t>&&, const char*, const bool,
+                                                  const LANG);                             // creates the param in place, parses defaults
+        };
+        struct sort_key {                                                                  // name of an entry of define_schema, as sorted
+            std::uint64_t                  word;                                           // 8 chars after the prefix common to all names
+            const char*                    name;                                           // param name without "--"
+            std::size_t                    entry;                                          // position of the entry
+        };
+        static const value_kind*  find_value_kind(const char* const);                      // kind of the named type, null if not built in
+        template<typename T>
+        static ParamHolder*       build_value(void* const, const std::string&, const Span<char>&,
+                                              std::vector<std::uint32_t>&&, const char*, const bool,
+                                              const LANG);                                 // Param<T> in place, defaults read from a '|' list
+    
+        /* cmd line parsing */
+        void                      parse_args(const int, char const* const* const);         // parses the given args
+        void                      split_command();                                         // splits line_buffer in place into line_args
+        void                      parse_line();                                            // parses line_args from default values
+        void                      reset_values();                                          // restores default values, forgets subcommand
+        void                      add_constraint(const CONSTRAINT, const std::string&,
+                                       const std::vector<std::string>&, const std::size_t); // checks names and stores rule
+        void                      compile_constraints();                                   // builds masks from constraints
+        void                      check_constraints();                                     // throws if a rule is broken
+        void                      parse_param(ParamHolder* const, int&, const int,
+                                              char const* const* const);                   // reads values of param at argv[i]
+        void                      parse_positional(const positional&, const int, const int,
+                                                   char const* const* const);              // reads argv[i] into a positional slot
+        const std::string         positional_use(const ParamHolder* const)     const;      // "<file>...", as printed in the help menu
+        template<typename T>
+        static typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, bool>::value>::type
+                                  throw_parse_error(const PARSE, const std::string&, const std::string&,
+                                                    const std::string&, const LANG);       // integer expected, or out of range
+        template<typename T>
+        static typename std::enable_if<std::is_floating_point<T>::value>::type
+                                  throw_parse_error(const PARSE, const std::string&, const std::string&,
+                                                    const std::string&, const LANG);       // decimal expected, or out of range
+        template<typename T>
+        static typename std::enable_if<!std::is_arithmetic<T>::value || std::is_same<T, bool>::value>::type
+                                  throw_parse_error(const PARSE, const std::string&, const std::string&,
+                                                    const std::string&, const LANG);       // value of type T expected
+    
+        /* units */
+        struct unit_suffix {                                                               // one unit, its factor is in the smallest unit of its family
+            const char*                    suffix;                                         // as typed after the number
+            std::uint64_t                  factor;                                         // nb of smallest units in this unit
+            bool                           shown;                                          // used when printing values
+        };
+        struct unit_family {                                                               // a family of units, and the unit values are stored in
+            const unit_suffix*             suffixes;                                       // units accepted after the number
+            std::size_t                    nb_suffixes;                                    // nb of units
+            std::uint64_t                  base;                                           // factor of the base unit
+            const char*                    base_suffix;                                    // printed after values in the base unit
+            const char*                    base_name;                                      // base unit, for error messages
+        };
+        static const unit_family& unit_family_of(const UNIT);                              // suffixes and base unit of the UNIT
+        static const PARSE        scale_unit(const UNIT, const char*, const char* const,
+                                             bool&, std::uint64_t&);                       // reads "4GiB" as a magnitude in the base unit
+        static const std::string  unit_text(const UNIT, const bool, const std::uint64_t); // magnitude in the largest exact unit, like "4GiB"
+        static const std::string  unit_base(const UNIT);                                   // name of the base unit
+        static const std::string  unit_list(const UNIT);                                   // accepted units, for error messages
+    
+        /* help search */
+        enum FIELD {field_name, field_value, field_choice, field_description, field_choice_description};
+        struct posting {                                                                   // where a word of the help menu appears
+            std::uint32_t                  param;                                          // id of the param
+            std::uint32_t                  field;                                          // FIELD the word is in
+            std::uint32_t                  choice;                                         // position of the choice, for choice fields
+        };
+        template<typename F>
+        static void               for_each_word(const char*, const char* const, const std::size_t,
+                                                std::string&, F);                          // calls f with each word of at least min_len chars, in lower case
+        void                      build_help_index()                           const;      // indexes the words of the params, by word
+        enum : std::uint32_t {search_version = 1};                                         // version of the format of saved indexes
+        static const char* const  search_magic();                                          // first 4 bytes of a saved index
+        const unsigned long long  help_fingerprint()                           const;      // hash of the schema and of the texts indexed
+        const bool                parse_search_index(const char* const,
+                                                     const std::size_t)        const;      // reads a saved index, false if invalid
+    
+        /* completion */
+        enum : std::size_t {index_num_len = 10};                                           // digits of the numbers of an index
+        static const char         index_sep = '\x1f';                                      // between values names, and between choices
+        static const char* const  index_header();                                          // first line of an index
+        const std::string         build_completion_index()                     const;      // serializes names, values names and choices
+        static void               complete_query(const char* const, const std::size_t,
+                                                 const int, char const* const* const);     // prints candidates found in an index
+    
+        /* snapshots */
+        enum : std::uint32_t {snapshot_version = 3};                                       // version of the format of snapshots
+        enum : std::size_t {snapshot_header_len       = 4 + 4 + 8 + 4,                     // magic, version, fingerprint and nb of params
+                            snapshot_param_header_len = 1 + 4};                            // is_defined and occurrences, before the values of a param
+        static const char* const  snapshot_magic();                                        // first 4 bytes of a snapshot
+        const unsigned long long  schema_fingerprint()                         const;      // hash of the parameters definitions
+        template<typename T>
+        static void               put_value(std::string&, const T&);                       // appends native representation of value
+        static void               put_value(std::string&, const std::string&);             // appends length and characters
+        static void               put_value(std::string&, const bool);                     // appends one byte, 0 or 1
+        template<typename T>
+        static const bool         get_value(const char*&, const char* const, T&);          // reads value, false if blob too short
+        static const bool         get_value(const char*&, const char* const, std::string&);
+        static const bool         get_value(const char*&, const char* const, bool&);       // false if the byte is not 0 or 1
     
         /* cmd line */
         const int                 argc;                                                    // command line args number
@@ -222,12 +874,51 @@ class Parameters {
         bool                      description_is_set;                                      // true if set_description() is called
         std::string               usage;                                                   // usage of the program
         bool                      usage_is_set;                                            // true if set_usage() is called
+        std::size_t               layout_jobs;                                             // nb of threads laying out the menu, 1 by default
+        std::size_t               layout_params_per_job;                                   // fewer params per thread are laid out by fewer threads
         std::vector<std::string>  subsections;                                             // sub sections titles in the help menu
         std::vector<std::size_t>  subs_indexes;                                            // indexes of the subsections (where to print them)
+        StringPool                pool;                                                    // values names and descriptions that are not literal()
         map_params                params;                                                  // data structure that stores all the parameters
-        map_order                 order;                                                   // data structure to store order of parameters
-        map_choices               choices;                                                 // stores choices associated to choice-parameters
-        std::set<std::string>     choices_params;                                          // stores all the params that are multiple choice
+        vec_order                 order;                                                   // parameters by id, in definition order
+        map_subcommands           subcommands;                                             // description and factory of each subcommand
+        std::vector<std::string>  subcommands_order;                                       // subcommands in definition order
+        std::string               sub_name;                                                // name of the invoked subcommand
+        std::unique_ptr<Parameters> sub;                                                   // invoked subcommand, created by parse_params
+        Parameters* const         parent;                                                  // parameters of the main command for a subcommand
+        std::vector<constraint>   constraints;                                             // rules, as declared
+        std::vector<std::vector<std::size_t>> rules_of;                                    // rules printed under each param, by id
+        std::vector<compiled_constraint> compiled;                                         // rules, as masks over params ids
+        std::vector<std::size_t>  ranged;                                                  // ids of params with a range
+        std::size_t               compiled_size;                                           // nb of params when rules were compiled, 0 to recompile
+        mutable std::mutex        search_mutex;                                            // serializes searches, the first one builds the index
+        mutable std::size_t       indexed_size;                                            // nb of params when the index was built, 0 to rebuild
+        mutable std::vector<std::string>   index_words;                                    // distinct words of the help menu, sorted
+        mutable std::vector<std::uint32_t> index_starts;                                   // first posting of each word, then the nb of postings
+        mutable std::vector<posting>       index_postings;                                 // where each word appears, grouped by word
+        mask                      given;                                                   // bit set for each param given on the cmd line
+        std::string               line_buffer;                                             // args of the last parsed command, NUL separated
+        std::vector<const char*>  line_args;                                               // argv for the last parsed command, into line_buffer
+        std::vector<positional>   positionals;                                             // positional slots, in definition order
+        Span<const char*>         rest;                                                    // args after "--", into the parsed argv
+        std::vector<std::unique_ptr<std::max_align_t[]>> batches;                          // storage of the params built by define_schema
+        std::deque<std::string>   schemas;                                                 // loaded schema files, split in place, entries point into them
+    
+        /* published snapshots */
+        enum : std::size_t {max_readers = 256};                                            // max nb of threads inside a ReadGuard at once
+        struct reader_table {                                                              // shared by all the objects
+            std::atomic<unsigned long long> epoch;                                         // global epoch, incremented when a snapshot is retired
+            std::atomic<unsigned long long> epochs[max_readers];                           // epoch seen by each active reader, 0 if none
+            std::atomic<bool>               slots[max_readers];                            // slots of epochs held by an outer guard
+        };
+        static reader_table&      readers();                                               // the table, a local static to have one in header-only builds
+        static std::size_t&       read_guards_depth();                                     // nb of guards held by the calling thread
+        static const std::size_t  acquire_reader_slot();                                   // takes a free slot, waits if there is none
+        std::atomic<const Snapshot*> current;                                              // snapshot seen by new readers
+        std::vector<std::pair<const Snapshot*, unsigned long long>> retired;               // old snapshots, and the epoch they were retired at
+        std::mutex                publish_mutex;                                           // serializes publish and reparse
+        void                      publish_locked();                                        // publish, with publish_mutex held
+        void                      reclaim();                                               // frees snapshots that no reader can see
     
     
     private:
@@ -236,23 +927,56 @@ class Parameters {
 
             public:
             
-                ParamHolder(const std::string& p_name, const std::string& p_description, const std::string& p_type_name, const std::vector<std::string>& p_values_names={}, const bool p_display_default_value=false):
+                ParamHolder(const std::string& p_name, const Span<char>& p_description, const char* const p_type_name, const void* const p_value_type, std::vector<std::uint32_t>&& p_values_names={}, const bool p_display_default_value=false):
                     name(p_name),
-                    description(p_description + " "),
+                    description(p_description),
                     nb_values(static_cast<int>(p_values_names.size())),
-                    values_names(p_values_names),
+                    values_names(std::move(p_values_names)),
                     type_name(p_type_name),
+                    value_type(p_value_type),
                     display_default_value(p_display_default_value),
-                    is_defined(false) {}
+                    positional(false),
+                    in_batch(false),
+                    is_choice(false),
+                    is_defined(false),
+                    bound_spec(nullptr),
+                    id(0),
+                    occurrence(occurrence_last),
+                    occurrences(0) {}
                 virtual ~ParamHolder() {}
+                
+                void specify(const bool p_is_defined) {
+                    is_defined = p_is_defined;
+                    if(bound_spec) *bound_spec = p_is_defined;
+                }
+                
+                virtual void       write_values(std::string&) const = 0;                   // appends values to a snapshot
+                virtual const bool read_values(const char*&, const char* const) = 0;       // reads values from a snapshot
+                virtual const bool skip_values(const char*&, const char* const) const = 0; // moves past values in a snapshot
+                virtual void       reset() = 0;                                            // restores default values
+                virtual void       accumulate() = 0;                                       // appends current values to accumulated ones
+                virtual void       reserve_accumulated(const std::size_t) = 0;             // reserves room for n more occurrences
+                virtual const bool out_of_bounds(std::string&) const = 0;                   // gives first value out of range, if any
+                virtual const std::string range_text() const = 0;                           // range as "[min, max]", empty if none
+                virtual void       read_text(const std::size_t, const char* const,
+                                             const char* const, const LANG) = 0;           // parses and stores value j
+                virtual const std::string default_text() const = 0;                         // default values, as printed in the help menu
             
-                const std::string              name;                                       // param name with added suffix '--'
-                const std::string              description;                                // long description paragraph, can't start or end with ' '
-                const int                      nb_values;                                  // nb of values expected for the parameters
-                const std::vector<std::string> values_names;                               // name of these values, without '<' and '>'
-                const std::string              type_name;                                  // to distinguish the type of the values
-                const bool                     display_default_value;                      // if default value has to be displayed in help menu
-                bool                           is_defined;                                 // if the arg was specified by the user
+                const std::string&               name;                                     // param name with added suffix '--', key in params
+                const Span<char>                 description;                              // long description paragraph, literal or pooled
+                const int                        nb_values;                                // nb of values expected for the parameters
+                const std::vector<std::uint32_t> values_names;                             // ids in pool of the names of these values
+                const char* const                type_name;                                // to distinguish the type of the values
+                const void* const                value_type;                               // type_tag of the values, checked instead of a dynamic_cast
+                const bool                       display_default_value;                    // if default value has to be displayed in help menu
+                bool                             positional;                               // if the param takes the args that are not parameters
+                bool                             in_batch;                                 // if built in a batch of define_schema, destroyed but not deleted
+                bool                             is_choice;                                // if the param is a ChoiceParam
+                bool                             is_defined;                               // if the arg was specified by the user
+                bool*                            bound_spec;                               // user variable that mirrors is_defined
+                std::size_t                      id;                                       // position in order, set when stored
+                OCCURRENCE                       occurrence;                               // what to do when the param is given again
+                std::size_t                      occurrences;                              // nb of times the param was given
             
             
             private:
@@ -267,18 +991,337 @@ class Parameters {
 
             public:
             
-                Param(const std::string& p_name, const std::string& p_description, const std::vector<std::string>& p_values_names, const std::vector<T>& p_default_values, const bool p_display_default_value):
-                    ParamHolder(p_name, p_description, typeid(T).name(), p_values_names, p_display_default_value),
-                    values(p_default_values),
-                    def_values(p_default_values) {}
-                Param(const std::string& p_name, const std::string& p_description):
-                    ParamHolder(p_name, p_description, typeid(T).name()) {}
+                Param(const std::string& p_name, const Span<char>& p_description, std::vector<std::uint32_t>&& p_values_names, std::vector<T>&& p_default_values, const bool p_display_default_value):
+                    ParamHolder(p_name, p_description, ParseTraits<T>::name(), type_tag<T>(), std::move(p_values_names), p_display_default_value),
+                    def_values(std::move(p_default_values)),
+                    bound_value(nullptr),
+                    bound_values(nullptr),
+                    outside(nullptr),
+                    min_value(),
+                    max_value() {}
+                Param(const std::string& p_name, const Span<char>& p_description):
+                    ParamHolder(p_name, p_description, ParseTraits<T>::name(), type_tag<T>()),
+                    bound_value(nullptr),
+                    bound_values(nullptr),
+                    outside(nullptr),
+                    min_value(),
+                    max_value() {}
                 virtual ~Param() {}
                 
-                std::vector<T>       values;                                               // parameter values
+                /* values share the defaults until one of them is written */
+                const std::vector<T>& current() const { return values.empty() ? def_values : values; }
+                
+                /* bindings receive the default values right away, then every parsed value */
+                void bind(T& dest)              { bound_value  = &dest; dest = current().at(0); }
+                void bind(std::vector<T>& dest) { bound_values = &dest; dest = current(); }
+                void set(const std::size_t j, const T& value) {
+                    if(values.empty()) values = def_values;
+                    values[j] = value;
+                    if(bound_values)     (*bound_values)[j] = value;
+                    else if(bound_value) *bound_value       = value;
+                }
+                
+                virtual void write_values(std::string& blob) const {
+                    const std::vector<T>& vals = current();
+                    for(std::size_t j=0 ; j<vals.size() ; j++) put_value(blob, static_cast<const T&>(vals[j]));
+                    put_value<std::uint32_t>(blob, static_cast<std::uint32_t>(accumulated.size()));
+                    for(std::size_t j=0 ; j<accumulated.size() ; j++) put_value(blob, static_cast<const T&>(accumulated[j]));
+                }
+                virtual const bool read_values(const char*& pos, const char* const end) {
+                    for(std::size_t j=0 ; j<def_values.size() ; j++) {
+                        T value;
+                        if(!get_value(pos, end, value)) return false;
+                        set(j, value);
+                    }
+                    std::uint32_t nb_accumulated = 0;
+                    if(!get_value(pos, end, nb_accumulated)) return false;
+                    accumulated.clear();
+                    accumulated.reserve(nb_accumulated);
+                    for(std::size_t j=0 ; j<nb_accumulated ; j++) {
+                        T value;
+                        if(!get_value(pos, end, value)) return false;
+                        accumulated.push_back(value);
+                    }
+                    return true;
+                }
+                virtual const bool skip_values(const char*& pos, const char* const end) const {
+                    for(std::size_t j=0 ; j<def_values.size() ; j++) {
+                        T value;
+                        if(!get_value(pos, end, value)) return false;
+                    }
+                    std::uint32_t nb_accumulated = 0;
+                    if(!get_value(pos, end, nb_accumulated)) return false;
+                    for(std::size_t j=0 ; j<nb_accumulated ; j++) {
+                        T value;
+                        if(!get_value(pos, end, value)) return false;
+                    }
+                    return true;
+                }
+                virtual void reset() {
+                    /* back to sharing the defaults, the capacity is kept for the next parse */
+                    values.clear();
+                    if(bound_values)                             std::copy(def_values.begin(), def_values.end(), bound_values->begin());
+                    else if(bound_value && !def_values.empty()) *bound_value = def_values[0];
+                    specify(false);
+                    occurrences = 0;
+                    accumulated.clear();
+                }
+                virtual void accumulate() {
+                    const std::vector<T>& vals = current();
+                    accumulated.insert(accumulated.end(), vals.begin(), vals.end());
+                }
+                virtual void reserve_accumulated(const std::size_t n) {
+                    accumulated.reserve(accumulated.size() + n*def_values.size());
+                }
+                virtual const bool out_of_bounds(std::string& value) const {
+                    if(!outside) return false;
+                    /* accumulated occurrences and positional args are all in accumulated */
+                    for(const T& v: accumulated.empty() ? current() : accumulated) {
+                        if(outside(v, min_value, max_value)) { value = ParseTraits<T>::format(v); return true; }
+                    }
+                    return false;
+                }
+                virtual const std::string range_text() const {
+                    if(!outside) return "";
+                    return "[" + ParseTraits<T>::format(min_value) + ", " + ParseTraits<T>::format(max_value) + "]";
+                }
+                virtual void read_text(const std::size_t j, const char* const first, const char* const last, const LANG lang) {
+                    T value = T();
+                    const PARSE parsed = ParseTraits<T>::parse(first, last, value);
+                    if(parsed!=parse_ok) return throw_parse_error<T>(parsed, name, std::string(first, last), "Parameters::parse_params", lang);
+                    set(j, value);
+                }
+                virtual const std::string default_text() const {
+                    std::string text;
+                    for(const T& value: def_values) {
+                        if(!text.empty()) text += ", ";
+                        text += ParseTraits<T>::format(value);
+                    }
+                    return text;
+                }
+                
+                /* only instantiated by set_range, so that T needs operator< only for ranges */
+                static const bool is_outside(const T& value, const T& min, const T& max) { return value<min || max<value; }
+                
+                std::vector<T>       values;                                               // parameter values, empty while equal to defaults
                 const std::vector<T> def_values;                                           // parameter default values
+                std::vector<T>       accumulated;                                          // values of all occurrences, with occurrence_accumulate
+                T*                   bound_value;                                          // user variable receiving the first value
+                std::vector<T>*      bound_values;                                         // user variable receiving all the values
+                const bool         (*outside)(const T&, const T&, const T&);               // compares a value with the range, null if none
+                T                    min_value;                                            // smallest accepted value
+                T                    max_value;                                            // largest accepted value
 
         };
+    
+        class ChoiceParam: public Param<std::string> {
+
+            public:
+            
+                ChoiceParam(const std::string& p_name, const Span<char>& p_description, std::vector<std::uint32_t>&& p_value_name, const std::size_t p_default_choice, vec_choices&& p_choices, const bool p_display_default_value):
+                    Param<std::string>(p_name, p_description, std::move(p_value_name), {p_choices.at(p_default_choice).first}, p_display_default_value),
+                    choices(std::move(p_choices)),
+                    default_choice(p_default_choice),
+                    choice(p_default_choice),
+                    bound_choice(nullptr) {
+                    is_choice = true;
+                    for(std::size_t i=0 ; i<choices.size() ; i++) index.insert(std::make_pair(std::cref(choices[i].first), i));
+                }
+                virtual ~ChoiceParam() {}
+                
+                void choose(const std::size_t p_choice) {
+                    choice = p_choice;
+                    if(bound_choice) bound_choice(p_choice);
+                }
+                
+                virtual const bool read_values(const char*& pos, const char* const end) {
+                    if(!Param<std::string>::read_values(pos, end)) return false;
+                    const choice_index::const_iterator it = index.find(current()[0]);
+                    if(it==index.end()) return false;
+                    choose(it->second);
+                    return true;
+                }
+                virtual const bool skip_values(const char*& pos, const char* const end) const {
+                    const char* value_pos = pos;
+                    std::string value;
+                    if(!get_value(value_pos, end, value) || index.find(value)==index.end()) return false;
+                    return Param<std::string>::skip_values(pos, end);
+                }
+                virtual void reset() {
+                    Param<std::string>::reset();
+                    choose(default_choice);
+                }
+                virtual void read_text(const std::size_t j, const char* const first, const char* const last, const LANG lang) {
+                    PARAMETERS_TRACE_SCOPE("validate_choice", j);
+                    const std::string arg_value(first, last);
+                    const choice_index::const_iterator it = index.find(arg_value);
+                    if(it==index.end()) {
+                        PARAMETERS_FAIL(error_unknown_choice, UnknownChoiceException(name, arg_value, "Parameters::parse_params", lang));
+                    }
+                    choose(it->second);
+                    set(j, arg_value);
+                }
+                
+                /* the index refers to the names in choices, that never move */
+                typedef std::unordered_map<std::reference_wrapper<const std::string>, std::size_t,
+                                           std::hash<std::string>, std::equal_to<std::string>> choice_index;
+                
+                const vec_choices                            choices;                      // choice names and descriptions, in definition order
+                choice_index                                 index;                        // position of each choice in choices
+                const std::size_t                            default_choice;               // position of the default choice
+                std::size_t                                  choice;                       // position of the current choice
+                std::function<void(const std::size_t)>       bound_choice;                 // stores the position in a user variable
+
+        };
+    
+        template<typename T>
+        class UnitParam: public Param<T> {
+
+            static_assert(std::is_integral<T>::value && !std::is_same<T, bool>::value, "values with units must have an integer type");
+
+            public:
+            
+                UnitParam(const std::string& p_name, const Span<char>& p_description, std::vector<std::uint32_t>&& p_values_names, std::vector<T>&& p_default_values, const bool p_display_default_value, const UNIT p_unit):
+                    Param<T>(p_name, p_description, std::move(p_values_names), std::move(p_default_values), p_display_default_value),
+                    unit(p_unit) {}
+                virtual ~UnitParam() {}
+                
+                virtual void read_text(const std::size_t j, const char* const first, const char* const last, const LANG lang) {
+                    bool          negative  = false;
+                    std::uint64_t magnitude = 0;
+                    const PARSE   scale     = scale_unit(unit, first, last, negative, magnitude);
+                    if(scale==parse_invalid) {
+                        PARAMETERS_FAIL(error_unit_expected, UnitExpectedException(this->name, std::string(first, last), unit_base(unit), unit_list(unit), "Parameters::parse_params", lang));
+                    }
+                    /* a negative value can go one further than a positive one */
+                    const std::uint64_t max = static_cast<std::uint64_t>(std::numeric_limits<T>::max());
+                    if(scale==parse_out_of_range || (negative && magnitude!=0 && (!std::is_signed<T>::value || magnitude-1>max)) || (!negative && magnitude>max)) {
+                        PARAMETERS_FAIL(error_value_out_of_range, ValueOutOfRangeException<T>(this->name, std::string(first, last), "Parameters::parse_params", lang));
+                    }
+                    if(negative && magnitude!=0) this->set(j, static_cast<T>(-static_cast<T>(magnitude-1)-1));
+                    else                         this->set(j, static_cast<T>(magnitude));
+                }
+                virtual const std::string default_text() const {
+                    std::string text;
+                    for(const T& value: this->def_values) {
+                        if(!text.empty()) text += ", ";
+                        const bool negative = value<static_cast<T>(0);
+                        text += unit_text(unit, negative, negative ? static_cast<std::uint64_t>(-(value+1))+1 : static_cast<std::uint64_t>(value));
+                    }
+                    return text;
+                }
+                
+                const UNIT unit;                                                           // family and base unit of the values
+
+        };
+    
+        /* type checks, without RTTI */
+        template<typename T>
+        static const void* const  type_tag();                                              // address unique to the type T
+        template<typename T>
+        static Param<T>* const    param_cast(ParamHolder* const);                          // p as a Param<T>, null if its values are not T
+        template<typename T>
+        static const Param<T>* const param_cast(const ParamHolder* const);                 // same, for a const param
+        static ChoiceParam* const choice_cast(ParamHolder* const);                         // p as a ChoiceParam, null if it is not one
+        static const ChoiceParam* const choice_cast(const ParamHolder* const);             // same, for a const param
+    
+        /* errors */
+        struct error_state {                                                               // error in the input, recorded without exceptions
+            ERROR_CODE                     code;                                           // error_none until an error is recorded
+            std::string                    message;                                        // message of the exception that was not thrown
+        };
+        static error_handler&     current_error_handler();                                 // set by set_error_handler, null by default
+        static error_state&       current_error();                                         // error of the calling thread, cleared by each entry point
+        static void               record_error(const ERROR_CODE, const std::exception&);   // keeps the error, for the caller to return
+        [[noreturn]] static void  fail(const std::exception&);                             // reports the error and aborts, without exceptions
+    
+        /* trace points */
+        static const std::size_t  trace_capacity = PARAMETERS_TRACE_CAPACITY;              // nb of events kept per thread, older ones are overwritten
+        struct trace_event {                                                               // one timed scope. Fields are atomic, and seq tells if the
+            std::atomic<std::uint64_t>     seq;                                            // event is complete: nb of the event + 1, or 0 while written
+            std::atomic<const char*>       name;                                           // name of the scope, a string literal
+            std::atomic<long long>         arg;                                            // value shown with the event, -1 if none
+            std::atomic<std::uint64_t>     start;                                          // steady clock, in ns
+            std::atomic<std::uint64_t>     duration;                                       // in ns
+            std::atomic<std::uint32_t>     tid;                                            // id of the thread that wrote it
+        };
+        struct trace_buffer {                                                              // ring of events, written by one thread at a time
+            trace_event                    events[trace_capacity];                         // event n is in events[n%trace_capacity]
+            std::atomic<std::uint64_t>     head;                                           // nb of events ever written
+            std::atomic<bool>              owned;                                          // false once its thread exited, it is then reused
+        };
+        struct trace_registry {                                                            // buffers of all the threads
+            std::mutex                     mutex;                                          // taken at the first event of a thread, and by dump_trace
+            std::vector<std::unique_ptr<trace_buffer>> buffers;                            // kept, so that the events of exited threads can be dumped
+            std::uint32_t                  next_tid;                                       // id of the last thread that took a buffer
+        };
+        class TraceScope {                                                                 // records the time spent in a scope
+            public:
+                TraceScope(const char* const p_name, const long long p_arg): name(p_name), arg(p_arg), start(trace_clock()) {}
+                ~TraceScope() { record_trace(name, arg, start, trace_clock()); }
+            private:
+                TraceScope(const TraceScope&);
+                TraceScope& operator=(const TraceScope&);
+                const char* const   name;                                                  // name of the event, a string literal
+                const long long     arg;                                                   // value shown with the event, -1 if none
+                const std::uint64_t start;                                                 // when the scope was entered
+        };
+        static const std::uint64_t trace_clock();                                          // steady clock, in ns
+        static trace_registry&    tracer();                                                // the registry, never destroyed
+        static void               record_trace(const char* const, const long long,
+                                               const std::uint64_t, const std::uint64_t); // appends an event to the ring of the thread
+
+
+    public:
+    
+        class Snapshot {
+        
+            public:
+            
+                template<typename T>
+                const T            num_val(const std::string&, const int=1)    const;      // same as Parameters::num_val
+                const std::string  str_val(const std::string&, const int=1)    const;      // same as Parameters::str_val
+                const std::string& cho_val(const std::string&)                 const;      // same as Parameters::cho_val
+                const std::size_t  cho_index(const std::string&)               const;      // same as Parameters::cho_index
+                const bool         is_spec(const std::string&)                 const;      // same as Parameters::is_spec
+            
+            
+            private:
+            
+                friend class Parameters;
+            
+                Snapshot(const Parameters&);
+                Snapshot(const Snapshot&);
+                Snapshot& operator=(const Snapshot&);
+            
+                const ParamHolder* const find(const std::string&, const int, const std::string&) const;    // param, checks value number
+            
+                const Parameters&        schema;                                   // parameters definitions, never modified by readers
+                const std::string        blob;                                     // values, in the format of Parameters::snapshot
+                std::vector<std::size_t> offsets;                                  // position of each parameter in blob, by id
+        
+        };
+    
+        class ReadGuard {
+        
+            public:
+            
+                ReadGuard(const Parameters&);
+                ~ReadGuard();
+                const Snapshot& operator*()  const { return *snapshot; }
+                const Snapshot* operator->() const { return snapshot; }
+            
+            
+            private:
+            
+                ReadGuard(const ReadGuard&);
+                ReadGuard& operator=(const ReadGuard&);
+            
+                const bool        outer;                                           // false if nested in another guard of the same thread
+                const std::size_t slot;                                            // slot held in the reader table, if outer
+                const Snapshot*   snapshot;                                        // snapshot pinned until destruction
+        
+        };
 
 
     public:
@@ -335,8 +1378,8 @@ class Parameters {
             public:
                 DynamicCastFailedException(const std::string& p_param_name, const std::string& p_function, LANG p_lang) throw():
                     description(p_lang==lang_fr
-                        ? "dans " + p_function + " : le dynamic_cast sur le paramètre \"" + p_param_name + "\" a échoué, vérifiez que l'argument de template correspond bien au type du paramètre"
-                        : "in function " + p_function + ": dynamic_cast on parameter \"" + p_param_name + "\" failed, check that template argument matches the parameter's type") {}
+                        ? "dans " + p_function + " : la conversion du paramètre \"" + p_param_name + "\" a échoué, vérifiez que l'argument de template correspond bien au type du paramètre"
+                        : "in function " + p_function + ": cast of parameter \"" + p_param_name + "\" failed, check that template argument matches the parameter's type") {}
                 virtual ~DynamicCastFailedException() throw() {}
                 virtual const char* what()            const throw() { return description.c_str(); }
             private:
@@ -379,6 +1422,30 @@ class Parameters {
                 const std::string description;
         };
 
+        class InvalidValueException: public std::exception {
+            public:
+                InvalidValueException(std::string const& p_param_name, const std::string& arg_value, const std::string& p_type, const std::string& p_function, LANG p_lang) throw():
+                    description(p_lang==lang_fr
+                        ? "dans " + p_function + " : le paramètre \"" + p_param_name + "\" attend une valeur de type " + p_type + ", et a reçu \"" + arg_value + "\""
+                        : "in function " + p_function + ": parameter \"" + p_param_name + "\" expects a value of type " + p_type + ", but received \"" + arg_value + "\"") {}
+                virtual ~InvalidValueException() throw() {}
+                virtual const char* what()    const throw() { return description.c_str(); }
+            private:
+                const std::string description;
+        };
+
+        class UnitExpectedException: public std::exception {
+            public:
+                UnitExpectedException(std::string const& p_param_name, const std::string& arg_value, const std::string& p_base, const std::string& p_units, const std::string& p_function, LANG p_lang) throw():
+                    description(p_lang==lang_fr
+                        ? "dans " + p_function + " : le paramètre \"" + p_param_name + "\" attend un nombre entier de " + p_base + ", suivi éventuellement d'une unité parmi " + p_units + ", et a reçu \"" + arg_value + "\""
+                        : "in function " + p_function + ": parameter \"" + p_param_name + "\" expects a whole number of " + p_base + ", optionally followed by a unit among " + p_units + ", but received \"" + arg_value + "\"") {}
+                virtual ~UnitExpectedException() throw() {}
+                virtual const char* what()    const throw() { return description.c_str(); }
+            private:
+                const std::string description;
+        };
+
         class NotEnoughValuesException: public std::exception {
             public:
                 NotEnoughValuesException(std::string const& p_param_name, const int nb_values, const int rec_values, const std::string& p_function, LANG p_lang) throw():
@@ -409,6 +1476,102 @@ class Parameters {
                 const std::string description;
         };
 
+        class InvalidSnapshotException: public std::exception {
+            public:
+                InvalidSnapshotException(const std::string& p_function, LANG p_lang) throw():
+                    description(p_lang==lang_fr
+                        ? "dans " + p_function + " : l'instantané est tronqué ou ne correspond pas aux paramètres définis"
+                        : "in function " + p_function + ": the snapshot is truncated or does not match the defined parameters") {}
+                virtual ~InvalidSnapshotException() throw() {}
+                virtual const char* what()    const throw() { return description.c_str(); }
+            private:
+                const std::string description;
+        };
+
+        class NothingPublishedException: public std::exception {
+            public:
+                NothingPublishedException(const std::string& p_function, LANG p_lang) throw():
+                    description(p_lang==lang_fr
+                        ? "dans " + p_function + " : aucune valeur n'a été publiée, appelez publish() ou reparse() d'abord"
+                        : "in function " + p_function + ": no values were published, call publish() or reparse() first") {}
+                virtual ~NothingPublishedException() throw() {}
+                virtual const char* what()    const throw() { return description.c_str(); }
+            private:
+                const std::string description;
+        };
+
+        class UnknownSubcommandException: public std::exception {
+            public:
+                UnknownSubcommandException(const std::string& p_subcommand, const std::string& p_function, LANG p_lang) throw():
+                    description(p_lang==lang_fr
+                        ? "dans " + p_function + " : sous-commande \"" + p_subcommand + "\" inconnue"
+                        : "in function " + p_function + ": unknown subcommand \"" + p_subcommand + "\"") {}
+                virtual ~UnknownSubcommandException() throw() {}
+                virtual const char* what()    const throw() { return description.c_str(); }
+            private:
+                const std::string description;
+        };
+
+        class DuplicateOccurrenceException: public std::exception {
+            public:
+                DuplicateOccurrenceException(const std::string& p_param_name, const std::string& p_function, LANG p_lang) throw():
+                    description(p_lang==lang_fr
+                        ? "dans " + p_function + " : le paramètre \"" + p_param_name + "\" ne peut être donné qu'une fois"
+                        : "in function " + p_function + ": parameter \"" + p_param_name + "\" can only be given once") {}
+                virtual ~DuplicateOccurrenceException() throw() {}
+                virtual const char* what()    const throw() { return description.c_str(); }
+            private:
+                const std::string description;
+        };
+
+        class ValueOutOfBoundsException: public std::exception {
+            public:
+                ValueOutOfBoundsException(const std::string& p_param_name, const std::string& arg_value, const std::string& p_range, const std::string& p_function, LANG p_lang) throw():
+                    description(p_lang==lang_fr
+                        ? "dans " + p_function + " : le paramètre \"" + p_param_name + "\" doit être dans " + p_range + " mais a reçu " + arg_value
+                        : "in function " + p_function + ": parameter \"" + p_param_name + "\" must be in " + p_range + " but received " + arg_value) {}
+                virtual ~ValueOutOfBoundsException() throw() {}
+                virtual const char* what()    const throw() { return description.c_str(); }
+            private:
+                const std::string description;
+        };
+
+        class MissingRequiredParameterException: public std::exception {
+            public:
+                MissingRequiredParameterException(const std::string& p_param_name, const std::string& p_required, const std::string& p_function, LANG p_lang) throw():
+                    description(p_lang==lang_fr
+                        ? "dans " + p_function + " : le paramètre \"" + p_param_name + "\" requiert le paramètre \"" + p_required + "\""
+                        : "in function " + p_function + ": parameter \"" + p_param_name + "\" requires parameter \"" + p_required + "\"") {}
+                virtual ~MissingRequiredParameterException() throw() {}
+                virtual const char* what()    const throw() { return description.c_str(); }
+            private:
+                const std::string description;
+        };
+
+        class ConflictingParametersException: public std::exception {
+            public:
+                ConflictingParametersException(const std::string& p_param_name, const std::string& p_other, const std::string& p_function, LANG p_lang) throw():
+                    description(p_lang==lang_fr
+                        ? "dans " + p_function + " : les paramètres \"" + p_param_name + "\" et \"" + p_other + "\" sont incompatibles"
+                        : "in function " + p_function + ": parameters \"" + p_param_name + "\" and \"" + p_other + "\" cannot be used together") {}
+                virtual ~ConflictingParametersException() throw() {}
+                virtual const char* what()    const throw() { return description.c_str(); }
+            private:
+                const std::string description;
+        };
+
+        class GroupConstraintException: public std::exception {
+            public:
+                GroupConstraintException(const std::string& p_group, const bool p_exactly, const std::size_t p_max, const std::size_t p_given, const std::string& p_function, LANG p_lang) throw():
+                    description(p_lang==lang_fr
+                        ? "dans " + p_function + " : " + (p_exactly ? "exactement " : "au plus ") + std::to_string(p_max) + " paramètre(s) parmi " + p_group + " attendu(s), " + std::to_string(p_given) + " reçu(s)"
+                        : "in function " + p_function + ": expected " + (p_exactly ? "exactly " : "at most ") + std::to_string(p_max) + " parameter(s) among " + p_group + ", received " + std::to_string(p_given)) {}
+                virtual ~GroupConstraintException() throw() {}
+                virtual const char* what()    const throw() { return description.c_str(); }
+            private:
+                const std::string description;
+        };
+
         class UnknownChoiceException: public std::exception {
             public:
                 UnknownChoiceException(std::string const& p_param_name, const std::string& arg_value, const std::string& p_function, LANG p_lang) throw():
@@ -420,6 +1583,54 @@ class Parameters {
             private:
                 const std::string description;
         };
+    
+        class UnbalancedQuoteException: public std::exception {
+            public:
+                UnbalancedQuoteException(const char quote, const std::size_t position, const std::string& p_function, LANG p_lang) throw():
+                    description(p_lang==lang_fr
+                        ? "dans " + p_function + " : le guillemet " + quote + " ouvert au caractère " + std::to_string(position) + " n'est pas fermé"
+                        : "in function " + p_function + ": quote " + quote + " opened at character " + std::to_string(position) + " is not closed") {}
+                virtual ~UnbalancedQuoteException() throw() {}
+                virtual const char* what()    const throw() { return description.c_str(); }
+            private:
+                const std::string description;
+        };
+
+        class InvalidDescriptorException: public std::exception {
+            public:
+                InvalidDescriptorException(const std::size_t position, const std::string& p_function, LANG p_lang) throw():
+                    description(p_lang==lang_fr
+                        ? "dans " + p_function + " : l'entrée " + std::to_string(position) + " du schéma est incomplète ou mal formée"
+                        : "in function " + p_function + ": entry " + std::to_string(position) + " of the schema is incomplete or malformed") {}
+                virtual ~InvalidDescriptorException() throw() {}
+                virtual const char* what()      const throw() { return description.c_str(); }
+            private:
+                const std::string description;
+        };
+
+        class InvalidSchemaException: public std::exception {
+            public:
+                InvalidSchemaException(const std::string& p_path, const std::size_t line, const std::string& p_function, LANG p_lang) throw():
+                    description(p_lang==lang_fr
+                        ? "dans " + p_function + " : la ligne " + std::to_string(line) + " du schéma \"" + p_path + "\" n'est pas valide"
+                        : "in function " + p_function + ": line " + std::to_string(line) + " of schema \"" + p_path + "\" is invalid") {}
+                virtual ~InvalidSchemaException() throw() {}
+                virtual const char* what()  const throw() { return description.c_str(); }
+            private:
+                const std::string description;
+        };
+
+        class UnreadableSchemaException: public std::exception {
+            public:
+                UnreadableSchemaException(const std::string& p_path, const std::string& p_function, LANG p_lang) throw():
+                    description(p_lang==lang_fr
+                        ? "dans " + p_function + " : le schéma \"" + p_path + "\" ne peut pas être lu"
+                        : "in function " + p_function + ": schema \"" + p_path + "\" cannot be read") {}
+                virtual ~UnreadableSchemaException() throw() {}
+                virtual const char* what()     const throw() { return description.c_str(); }
+            private:
+                const std::string description;
+        };
 
 };
 
@@ -427,75 +1638,254 @@ class Parameters {
 /*** template functions definition ***/
 
 template<typename T>
-void Parameters::define_num_str_param(const std::string& param_name, const std::vector<std::string>& values_names, const std::vector<T>& default_param_values, const std::string& param_desc, const bool display_default_value) {
+const void* const Parameters::type_tag() {
+    /* one object per type, even across files since the function is inline, and not const so
+       that the linker cannot merge the tags of two types */
+    static char tag = 0;
+    return &tag;
+}
+
+template<typename T>
+Parameters::Param<T>* const Parameters::param_cast(ParamHolder* const p) {
+    return p->value_type==type_tag<T>() ? static_cast<Param<T>*>(p) : nullptr;
+}
+
+template<typename T>
+const Parameters::Param<T>* const Parameters::param_cast(const ParamHolder* const p) {
+    return p->value_type==type_tag<T>() ? static_cast<const Param<T>*>(p) : nullptr;
+}
+
+template<typename P, typename... Args>
+P* const Parameters::add_param(const std::string& param_name, Args&&... args) {
+    PARAMETERS_TRACE_SCOPE("define_param", order.size());
     /* check if already exist */
-    if(params.count("--" + param_name)) {
-        throw DuplicateParameterException(param_name, "Parameters::define_param", lang);
+    const std::pair<map_params::iterator, bool> ins = params.insert(std::make_pair("--" + param_name, nullptr));
+    if(!ins.second) {
+        PARAMETERS_THROW(DuplicateParameterException(param_name, "Parameters::define_param", lang));
+    }
+    /* create param, its name is the key in params */
+    P* p = nullptr;
+    PARAMETERS_TRY {
+        p = new P(ins.first->first, std::forward<Args>(args)...);
+    }
+    PARAMETERS_CATCH_ALL {
+        params.erase(ins.first);
+        PARAMETERS_RETHROW;
     }
-    /* get type name */
-    const std::string type_name = typeid(T).name();
-    /* create param */
-    Param<T>* const p = new Param<T>("--" + param_name, param_desc, values_names, default_param_values, display_default_value);
     /* store param */
-    order.insert(std::make_pair(params.size(), "--" + param_name));
-    params.insert(std::make_pair("--" + param_name, p));
+    ins.first->second = p;
+    p->id = order.size();
+    order.push_back(p);
+    return p;
+}
+
+template<std::size_t N>
+Parameters::Text Parameters::literal(const char (&str)[N]) {
+    return Text(str, Text::length(str, N));
+}
+
+template<typename T>
+void Parameters::define_num_str_param(const std::string& param_name, const std::vector<std::string>& values_names, std::vector<T> default_param_values, Text param_desc, const bool display_default_value) {
+    add_param<Param<T>>(param_name, keep(std::move(param_desc)), intern_all(values_names), std::move(default_param_values), display_default_value);
+}
+
+template<typename T>
+void Parameters::define_num_str_param(const std::string& param_name, const std::string& value_name, const T& default_param_value, Text param_desc, T& dest, const bool display_default_value) {
+    define_num_str_param<T>(param_name, std::vector<std::string>{value_name}, std::vector<T>{default_param_value}, std::move(param_desc), display_default_value);
+    param_cast<T>(params.at("--" + param_name))->bind(dest);
+}
+
+template<typename T>
+void Parameters::define_num_str_param(const std::string& param_name, const std::vector<std::string>& values_names, std::vector<T> default_param_values, Text param_desc, std::vector<T>& dest, const bool display_default_value) {
+    define_num_str_param<T>(param_name, values_names, std::move(default_param_values), std::move(param_desc), display_default_value);
+    param_cast<T>(params.at("--" + param_name))->bind(dest);
+}
+
+template<typename T>
+void Parameters::define_positional(const std::string& param_name, const std::string& value_name, const std::size_t min, const std::size_t max, Text param_desc) {
+    /* each arg is an occurrence of one value, all kept in the accumulated values */
+    Param<T>* const p = add_param<Param<T>>(param_name, keep(std::move(param_desc)), intern_all({value_name}), std::vector<T>(1), false);
+    p->positional = true;
+    p->occurrence = occurrence_accumulate;
+    positionals.push_back(positional{p, min, std::max(min, max)});
+}
+
+template<typename T>
+void Parameters::define_unit_param(const std::string& param_name, const std::vector<std::string>& values_names, const UNIT unit, std::vector<T> default_param_values, Text param_desc, const bool display_default_value) {
+    add_param<UnitParam<T>>(param_name, keep(std::move(param_desc)), intern_all(values_names), std::move(default_param_values), display_default_value, unit);
 }
 
 template<typename T>
-void Parameters::pr_def(ParamHolder* const p, const bool add_quotes) const {
-    if(typeid(T).name()!=typeid(short int    ).name() && typeid(T).name()!=typeid(unsigned short int    ).name()
-    && typeid(T).name()!=typeid(int          ).name() && typeid(T).name()!=typeid(unsigned int          ).name()
-    && typeid(T).name()!=typeid(long int     ).name() && typeid(T).name()!=typeid(unsigned long int     ).name()
-    && typeid(T).name()!=typeid(long long int).name() && typeid(T).name()!=typeid(unsigned long long int).name()
-    && typeid(T).name()!=typeid(float        ).name() && typeid(T).name()!=typeid(std::string           ).name()
-    && typeid(T).name()!=typeid(double       ).name() && typeid(T).name()!=typeid(long double           ).name()) {
-        throw UnsupportedParameterTypeException(typeid(T).name(), "Parameters::num_val", lang);
+void Parameters::define_unit_param(const std::string& param_name, const std::string& value_name, const UNIT unit, const T& default_param_value, Text param_desc, T& dest, const bool display_default_value) {
+    define_unit_param<T>(param_name, std::vector<std::string>{value_name}, unit, std::vector<T>{default_param_value}, std::move(param_desc), display_default_value);
+    param_cast<T>(params.at("--" + param_name))->bind(dest);
+}
+
+template<typename E>
+typename std::enable_if<std::is_enum<E>::value || (std::is_integral<E>::value && !std::is_same<E, bool>::value)>::type
+Parameters::define_choice_param(const std::string& param_name, const std::string& value_name, const std::string& default_choice, vec_choices p_choices, Text param_desc, E& dest, const bool display_default_value) {
+    define_choice_param(param_name, value_name, default_choice, std::move(p_choices), std::move(param_desc), display_default_value);
+    ChoiceParam* const p = choice_cast(params.at("--" + param_name));
+    p->bound_choice = [&dest] (const std::size_t choice) { dest = static_cast<E>(choice); };
+    p->bound_choice(p->choice);
+}
+
+template<typename T>
+void Parameters::set_range(const std::string& param_name, const T& min, const T& max) {
+    if(!params.count("--" + param_name)) {
+        PARAMETERS_THROW(UndefinedParameterException(param_name, "Parameters::set_range", lang));
+    }
+    Param<T>* const p_reint = param_cast<T>(params.at("--" + param_name));
+    if(p_reint==0) PARAMETERS_THROW(DynamicCastFailedException(param_name, "Parameters::set_range", lang));
+    p_reint->outside   = &Param<T>::is_outside;
+    p_reint->min_value = min;
+    p_reint->max_value = max;
+    compiled_size      = 0;
+}
+
+template<typename T>
+const Parameters::Span<T> Parameters::num_vals(const std::string& param_name) const {
+    if(params.count("--" + param_name)) {
+        Param<T>* const p_reint = param_cast<T>(params.at("--" + param_name));
+        if(p_reint==0) PARAMETERS_THROW(DynamicCastFailedException(param_name, "Parameters::num_vals", lang));
+        return Span<T>(p_reint->accumulated.data(), p_reint->accumulated.size());
     }
     else {
-        const Param<T>* const p_reint = dynamic_cast<Param<T>* const>(p);
-        if(p_reint==0) {
-            throw DynamicCastFailedException(p->name, "Parameters::pr_def", lang);
-        }
-        if(lang==lang_fr) std::cout << desc_indent << bold("Défaut :");
-        else              std::cout << desc_indent << bold("Default:");
-        for(int j=0 ; j<p->nb_values ; j++) {
-            if(!add_quotes) { std::cout << " "   << p_reint->def_values[static_cast<std::size_t>(j)];         if(j<p->nb_values-1) std::cout << ","; }
-            else            { std::cout << " \"" << p_reint->def_values[static_cast<std::size_t>(j)] << "\""; if(j<p->nb_values-1) std::cout << ","; }
-        }
-        std::cout << std::endl;
+        PARAMETERS_THROW(UndefinedParameterException(param_name, "Parameters::num_vals", lang));
     }
 }
 
+template<typename It>
+void Parameters::parse_params(It first, It last) {
+    current_error().code = error_none;
+    /* reserve first, so that pointers to the args stay valid */
+    std::size_t size = 0;
+    for(It it=first ; it!=last ; ++it) size += it->size() + 1;
+    line_buffer.clear();
+    line_buffer.reserve(size);
+    line_args.assign(1, argc>0 ? argv[0] : "");
+    for(It it=first ; it!=last ; ++it) {
+        line_args.push_back(line_buffer.data() + line_buffer.size());
+        line_buffer.append(it->data(), it->size());
+        line_buffer.push_back('\0');
+    }
+    parse_line();
+}
+
+template<typename E>
+const E Parameters::cho_enum(const std::string& param_name) const {
+    return static_cast<E>(cho_index(param_name));
+}
+
 template<typename T>
 const T Parameters::num_val(const std::string& param_name, const int value_number) const {
     if(params.count("--" + param_name)) {
         Parameters::ParamHolder* const p = params.at("--" + param_name);
         if(value_number>p->nb_values) {
-            throw UndefinedValueException(param_name, p->nb_values, value_number, "Parameters::str_val", lang);
+            PARAMETERS_THROW(UndefinedValueException(param_name, p->nb_values, value_number, "Parameters::str_val", lang));
         }
         else {
-            if(typeid(T).name()!=typeid(short int    ).name() && typeid(T).name()!=typeid(unsigned short int    ).name()
-            && typeid(T).name()!=typeid(int          ).name() && typeid(T).name()!=typeid(unsigned int          ).name()
-            && typeid(T).name()!=typeid(long int     ).name() && typeid(T).name()!=typeid(unsigned long int     ).name()
-            && typeid(T).name()!=typeid(long long int).name() && typeid(T).name()!=typeid(unsigned long long int).name()
-            && typeid(T).name()!=typeid(float        ).name()
-            && typeid(T).name()!=typeid(double       ).name() && typeid(T).name()!=typeid(long double           ).name()) {
-                throw UnsupportedParameterTypeException(typeid(T).name(), "Parameters::num_val", lang);
-            }
-            else {
-                /* reinterpret with the good type */
-                Param<T>* const p_reint = dynamic_cast<Param<T>* const>(p);
-                if(p_reint==0) {
-                    throw DynamicCastFailedException(param_name, "Parameters::num_val", lang);
-                }
-                /* return value */
-                return p_reint->values[static_cast<std::size_t>(value_number-1)];
+            /* reinterpret with the good type, a type without ParseTraits does not compile */
+            Param<T>* const p_reint = param_cast<T>(p);
+            if(p_reint==0) {
+                PARAMETERS_THROW(DynamicCastFailedException(param_name, "Parameters::num_val", lang));
             }
+            /* return value */
+            return p_reint->current()[static_cast<std::size_t>(value_number-1)];
         }
     }
     else {
-        throw UndefinedParameterException(param_name, "Parameters::define_param", lang);
+        PARAMETERS_THROW(UndefinedParameterException(param_name, "Parameters::define_param", lang));
     }
 }
 
+template<typename T>
+const T Parameters::Snapshot::num_val(const std::string& param_name, const int value_number) const {
+    const ParamHolder* const p = find(param_name, value_number, "Parameters::Snapshot::num_val");
+    /* check type */
+    const Param<T>* const p_reint = param_cast<T>(p);
+    if(p_reint==0) PARAMETERS_THROW(DynamicCastFailedException(param_name, "Parameters::Snapshot::num_val", schema.lang));
+    /* read value, after the previous values */
+    const char*       pos = blob.data() + offsets[p->id];
+    const char* const end = blob.data() + blob.size();
+    T value = T();
+    for(int j=0 ; j<value_number ; j++) get_value(pos, end, value);
+    return value;
+}
+
+template<typename T>
+typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, bool>::value>::type
+Parameters::throw_parse_error(const PARSE parsed, const std::string& param_name, const std::string& arg_value, const std::string& function, const LANG lang) {
+    if(parsed==parse_invalid) PARAMETERS_FAIL(error_integer_expected, IntegerExpectedException(param_name, arg_value, function, lang));
+    else                      PARAMETERS_FAIL(error_value_out_of_range, ValueOutOfRangeException<T>(param_name, arg_value, function, lang));
+}
+
+template<typename T>
+typename std::enable_if<std::is_floating_point<T>::value>::type
+Parameters::throw_parse_error(const PARSE parsed, const std::string& param_name, const std::string& arg_value, const std::string& function, const LANG lang) {
+    if(parsed==parse_invalid) PARAMETERS_FAIL(error_decimal_expected, DecimalExpectedException(param_name, arg_value, function, lang));
+    else                      PARAMETERS_FAIL(error_value_out_of_range, ValueOutOfRangeException<T>(param_name, arg_value, function, lang));
+}
+
+template<typename T>
+typename std::enable_if<!std::is_arithmetic<T>::value || std::is_same<T, bool>::value>::type
+Parameters::throw_parse_error(const PARSE, const std::string& param_name, const std::string& arg_value, const std::string& function, const LANG lang) {
+    PARAMETERS_FAIL(error_invalid_value, InvalidValueException(param_name, arg_value, ParseTraits<T>::name(), function, lang));
+}
+
+template<typename T>
+Parameters::ParamHolder* Parameters::build_value(void* const place, const std::string& param_name, const Span<char>& param_desc, std::vector<std::uint32_t>&& values_names, const char* defaults, const bool display_default_value, const LANG lang) {
+    /* defaults are default-constructed when the list is null */
+    std::vector<T> default_values(values_names.size());
+    for(std::size_t j=0 ; defaults && j<default_values.size() ; j++) {
+        const char* last = defaults;
+        while(*last && *last!='|') last++;
+        /* traits expect a NUL after the chars */
+        const std::string item(defaults, last);
+        T value = T();
+        const PARSE parsed = ParseTraits<T>::parse(item.data(), item.data() + item.size(), value);
+        if(parsed!=parse_ok) throw_parse_error<T>(parsed, param_name, item, "Parameters::define_schema", lang);
+        if(PARAMETERS_FAILED) return nullptr;
+        default_values[j] = value;
+        defaults = last + 1;
+    }
+    return new(place) Param<T>(param_name, param_desc, std::move(values_names), std::move(default_values), display_default_value);
+}
+
+template<typename F>
+void Parameters::for_each_word(const char* first, const char* const last, const std::size_t min_len, std::string& word, F f) {
+    /* words are runs of letters and digits, bytes of UTF-8 chars count as letters */
+    auto in_word = [] (const char c) { return std::isalnum(static_cast<unsigned char>(c)) || static_cast<unsigned char>(c)>=0x80; };
+    while(first<last) {
+        while(first<last && !in_word(*first)) first++;
+        const char* stop = first;
+        while(stop<last && in_word(*stop)) stop++;
+        if(static_cast<std::size_t>(stop-first)>=min_len) {
+            word.assign(first, stop);
+            for(char& c: word) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+            f();
+        }
+        first = stop;
+    }
+}
+
+template<typename T>
+void Parameters::put_value(std::string& blob, const T& value) {
+    static_assert(std::is_trivially_copyable<T>::value, "values are copied byte by byte into snapshots");
+    blob.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template<typename T>
+const bool Parameters::get_value(const char*& pos, const char* const end, T& value) {
+    if(static_cast<std::size_t>(end-pos)<sizeof(T)) return false;
+    std::memcpy(&value, pos, sizeof(T));
+    pos += sizeof(T);
+    return true;
+}
+
+/* the whole library in the including file */
+#ifdef PARAMETERS_HEADER_ONLY
+    #include "Parameters.cpp"
+#endif
+
 #endif
@@ -0,0 +1,185 @@
+/*
+
+************************************************************************************************
+
+LICENSE
+
+    Help80 - Copyright (C) 2016 - Olivier Deiss - olivier.deiss@gmail.com
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+************************************************************************************************
+
+    Checks of the error codes of the header-only build, without exceptions and without RTTI:
+    each case gives a wrong command line, schema or snapshot, checks the code and the message
+    of the error, then checks that the object is still usable and that nothing was half done.
+
+    build: g++ -std=c++11 -fno-exceptions -fno-rtti -Isrc src/check_errors.cpp -pthread
+
+*/
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#define PARAMETERS_HEADER_ONLY
+#include "Parameters.hpp"
+
+#if PARAMETERS_EXCEPTIONS
+    #error "check_errors is built with -fno-exceptions"
+#endif
+
+static int failures = 0;
+
+static void expect(const bool ok, const std::string& what) {
+    if(!ok) { std::cerr << "FAILED: " << what << std::endl; failures++; }
+}
+
+/* true if the last call failed with the given code and a message naming the given text */
+static bool failed(const Parameters::ERROR_CODE code, const std::string& text) {
+    return Parameters::last_error()==code && Parameters::last_error_message().find(text)!=std::string::npos;
+}
+
+static bool succeeded() {
+    return Parameters::last_error()==Parameters::error_none && Parameters::last_error_message().empty();
+}
+
+static const Parameters::config p_c {40, 80, 3, 1, 27, 5, 3, 2, Parameters::lang_us};
+static char                     prog[] = "check";
+static char*                    args[] = {prog};
+
+/* errors in a command line, the next parse starts again from the default values */
+static void command_lines() {
+    Parameters p(1, args, p_c);
+    p.define_num_str_param<int>("n", {"value"}, {1}, "Bounded.");
+    p.define_choice_param("mode", "mode", "fast", {{"fast", "Fast."}, {"slow", "Slow."}}, "Mode.");
+    p.define_unit_param<int>("delay", {"duration"}, Parameters::unit_milliseconds, {0}, "Delay.");
+    p.define_positional<int>("sizes", "size", 0, Parameters::unbounded, "Sizes.");
+    p.set_range<int>("n", 0, 10);
+    p.parse_params("--nope");
+    expect(failed(Parameters::error_unknown_parameter, "--nope"), "unknown parameter");
+    p.parse_params("--n x --nope");
+    expect(failed(Parameters::error_integer_expected, "x"), "integer expected, the parse stops at the first error");
+    expect(!p.is_spec("n"), "a value that failed is not given");
+    p.parse_params("--n 99999999999");
+    expect(failed(Parameters::error_value_out_of_range, "99999999999"), "value out of range");
+    p.parse_params("--n 11");
+    expect(failed(Parameters::error_value_out_of_bounds, "--n"), "value out of bounds");
+    p.parse_params("--n");
+    expect(failed(Parameters::error_not_enough_values, "--n"), "not enough values");
+    p.parse_params("--mode medium");
+    expect(failed(Parameters::error_unknown_choice, "medium"), "unknown choice");
+    p.parse_params("--delay 5parsecs");
+    expect(failed(Parameters::error_unit_expected, "5parsecs"), "unit expected");
+    p.parse_params("--n ' 3");
+    expect(failed(Parameters::error_unbalanced_quote, "'"), "unbalanced quote");
+    p.parse_params("4 x --nope");
+    expect(failed(Parameters::error_integer_expected, "x"), "positional integer expected");
+    expect(p.num_vals<int>("sizes").size()==1, "a positional arg that failed is not accumulated");
+    p.parse_params("--n 3 --mode slow 4 5");
+    expect(succeeded(), "parse after errors");
+    expect(p.num_val<int>("n")==3 && p.cho_index("mode")==1 && p.num_vals<int>("sizes").size()==2, "values after errors");
+}
+
+/* an error in a subcommand stops the parse of the main command too */
+static void subcommands() {
+    Parameters p(1, args, p_c);
+    p.define_param("a", "A.");
+    p.define_param("b", "B.");
+    p.add_one_of_group({"a", "b"});
+    p.define_subcommand("run", "Runs.", [] (Parameters& sub) {
+        sub.define_num_str_param<int>("jobs", {"n"}, {1}, "Jobs.");
+    });
+    p.parse_params("run --jobs x");
+    expect(failed(Parameters::error_integer_expected, "x"), "error in the subcommand");
+    p.parse_params("run --jobs 2");
+    expect(failed(Parameters::error_group_constraint, "--a"), "rule of the main command");
+    p.parse_params("--b run --jobs 2");
+    expect(succeeded() && p.subcommand().num_val<int>("jobs")==2, "subcommand after errors");
+}
+
+/* a failed reparse publishes nothing and keeps its error */
+static void reparse() {
+    Parameters p(1, args, p_c);
+    p.define_num_str_param<int>("n", {"value"}, {0}, "Published.");
+    char const* const good[] = {"check", "--n", "7"};
+    char const* const bad[]  = {"check", "--n", "8", "--nope"};
+    p.reparse(3, good);
+    expect(succeeded(), "reparse");
+    p.reparse(4, bad);
+    expect(failed(Parameters::error_unknown_parameter, "--nope"), "failed reparse");
+    Parameters::ReadGuard guard(p);
+    expect(guard->num_val<int>("n")==7 && p.num_val<int>("n")==7, "values after a failed reparse");
+}
+
+/* a wrong snapshot changes nothing */
+static void snapshots() {
+    Parameters p(1, args, p_c);
+    p.define_num_str_param<int>("n", {"value"}, {0}, "Saved.");
+    p.parse_params("--n 5");
+    const std::string blob = p.snapshot();
+    p.parse_params("--n 6");
+    p.attach_snapshot(blob.data(), blob.size()-1);
+    expect(failed(Parameters::error_invalid_snapshot, "snapshot"), "truncated snapshot");
+    expect(p.num_val<int>("n")==6, "values after a wrong snapshot");
+    p.attach_snapshot(blob.data(), blob.size());
+    expect(succeeded() && p.num_val<int>("n")==5, "snapshot after errors");
+}
+
+/* a wrong schema defines nothing, the same names can be defined afterwards */
+static void schemas() {
+    const std::string path = "check_errors.schema";
+    Parameters p(1, args, p_c);
+    p.define_param("verbose", "Prints more.");
+    p.load_schema("check_errors.missing");
+    expect(failed(Parameters::error_unreadable_schema, "check_errors.missing"), "unreadable schema");
+    const std::string texts[] = {
+        "help80-schema 2\nparam\tquiet\tPrints less.\n",
+        "help80-schema 1\nparam\tquiet\tPrints less.\nparam\tverbose\tPrints more.\n",
+        "help80-schema 1\nsubsection\tValues\nparam\tquiet\tPrints less.\nvalue\twidth\tint\tvalue\twide\t1\tWidth.\n",
+        "help80-schema 1\nparam\tquiet\tPrints less.\nchoice\tcolor\tcolor\tred\tblue=Blue.|green=Green.\t1\tColor.\n"
+    };
+    const Parameters::ERROR_CODE codes[] = {Parameters::error_invalid_schema, Parameters::error_duplicate_parameter, Parameters::error_integer_expected, Parameters::error_unknown_choice};
+    for(std::size_t k=0 ; k<4 ; k++) {
+        { std::ofstream out(path, std::ios::binary); out << texts[k]; }
+        p.load_schema(path);
+        expect(Parameters::last_error()==codes[k], "wrong schema " + std::to_string(k));
+    }
+    std::remove(path.c_str());
+    const Parameters::descriptor entries[] = {
+        {Parameters::descriptor_param, "quiet", nullptr, nullptr, nullptr, nullptr, false, "Prints less."},
+        {Parameters::descriptor_value, "width", "float16", "value", nullptr, nullptr, false, "Width."}
+    };
+    p.define_schema(entries, 2);
+    expect(failed(Parameters::error_unsupported_type, "float16"), "unsupported type");
+    p.define_param("quiet", "Prints less.");
+    p.define_num_str_param<int>("width", {"value"}, {80}, "Width.");
+    p.parse_params("--quiet --width 100");
+    expect(succeeded() && p.is_spec("quiet") && p.num_val<int>("width")==100, "definitions after wrong schemas");
+}
+
+int main() {
+    command_lines();
+    subcommands();
+    reparse();
+    snapshots();
+    schemas();
+    if(failures!=0) {
+        std::cerr << failures << " failures" << std::endl;
+        return 1;
+    }
+    std::cout << "ok" << std::endl;
+    return 0;
+}
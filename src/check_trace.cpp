@@ -0,0 +1,201 @@
+/*
+
+************************************************************************************************
+
+LICENSE
+
+    Help80 - Copyright (C) 2016 - Olivier Deiss - olivier.deiss@gmail.com
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+************************************************************************************************
+
+    Checks of the trace, built with PARAMETERS_TRACE set to 1: defines, loads, parses and
+    prints a menu on two threads, then reads the Chrome trace JSON written by dump_trace. The
+    JSON must parse, each event must be a complete event with a known name, a non-negative
+    time and duration and a thread id, each phase must have been recorded, and the events of
+    a thread must nest in the event that contains them.
+
+    build: g++ -std=c++11 -DPARAMETERS_TRACE=1 -Isrc src/check_trace.cpp src/Parameters.cpp -pthread
+
+*/
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "Parameters.hpp"
+
+#if !PARAMETERS_TRACE
+    #error "check_trace is built with -DPARAMETERS_TRACE=1"
+#endif
+
+static int failures = 0;
+
+static void expect(const bool ok, const std::string& what) {
+    if(!ok) { std::cerr << "FAILED: " << what << std::endl; failures++; }
+}
+
+/* a JSON value, numbers are kept as doubles and objects as sorted members */
+struct json {
+    enum KIND {null, boolean, number, string, array, object} kind;
+    double                      num;
+    std::string                 str;
+    std::vector<json>           items;
+    std::map<std::string, json> members;
+    json(): kind(null), num(0) {}
+};
+
+/* reads one JSON value, false if the text is not JSON */
+class json_reader {
+    public:
+        json_reader(const std::string& p_text): text(p_text), pos(0) {}
+        bool read_document(json& value) { return read(value) && (skip(), pos==text.size()); }
+    private:
+        void skip() { while(pos<text.size() && (text[pos]==' ' || text[pos]=='\n' || text[pos]=='\r' || text[pos]=='\t')) pos++; }
+        bool eat(const char c) { skip(); if(pos<text.size() && text[pos]==c) { pos++; return true; } return false; }
+        bool read_string(std::string& out) {
+            if(!eat('"')) return false;
+            for( ; pos<text.size() && text[pos]!='"' ; pos++) {
+                if(static_cast<unsigned char>(text[pos])<' ') return false;
+                if(text[pos]=='\\') { if(++pos==text.size()) return false; }
+                out += text[pos];
+            }
+            return pos++<text.size();
+        }
+        bool read(json& value) {
+            skip();
+            if(pos==text.size()) return false;
+            const char c = text[pos];
+            if(c=='{') {
+                pos++;
+                value.kind = json::object;
+                if(eat('}')) return true;
+                do {
+                    std::string key;
+                    if(!read_string(key) || !eat(':') || !read(value.members[key])) return false;
+                } while(eat(','));
+                return eat('}');
+            }
+            if(c=='[') {
+                pos++;
+                value.kind = json::array;
+                if(eat(']')) return true;
+                do {
+                    value.items.emplace_back();
+                    if(!read(value.items.back())) return false;
+                } while(eat(','));
+                return eat(']');
+            }
+            if(c=='"') { value.kind = json::string; return read_string(value.str); }
+            if(text.compare(pos, 4, "true")==0 || text.compare(pos, 4, "null")==0) { value.kind = c=='n' ? json::null : json::boolean; pos += 4; return true; }
+            if(text.compare(pos, 5, "false")==0) { value.kind = json::boolean; pos += 5; return true; }
+            const char* const first = text.c_str() + pos;
+            char*             last  = nullptr;
+            value.kind = json::number;
+            value.num  = std::strtod(first, &last);
+            if(last==first) return false;
+            pos += static_cast<std::size_t>(last-first);
+            return true;
+        }
+        const std::string& text;
+        std::size_t        pos;
+};
+
+static const Parameters::config p_c {40, 80, 3, 1, 27, 5, 3, 2, Parameters::lang_us};
+static char                     prog[] = "check";
+static char*                    args[] = {prog};
+
+/* goes through every phase that has a trace point */
+static void run_phases() {
+    const std::string path = "check_trace.schema";
+    { std::ofstream out(path, std::ios::binary); out << "help80-schema 1\nvalue\twidth\tint\tvalue\t80\t1\tWidth.\nparam\tverbose\tPrints more.\n"; }
+    Parameters p(1, args, p_c);
+    p.define_num_str_param<int>("n", {"value"}, {1}, "A number, with a long description to lay out.");
+    p.define_choice_param("mode", "mode", "fast", {{"fast", "Fast."}, {"slow", "Slow."}}, "A choice.");
+    p.set_range<int>("n", 0, 10);
+    p.load_schema(path);
+    std::remove(path.c_str());
+    p.parse_params("--n 3 --mode slow --width 100 --verbose");
+    p.set_layout_jobs(2, 1);
+    std::string menu;
+    Parameters::PlainRenderer r(menu);
+    p.print_help(r, false, false);
+}
+
+int main() {
+    run_phases();
+    std::ostringstream out;
+    Parameters::dump_trace(out);
+    const std::string text = out.str();
+
+    json doc;
+    json_reader reader(text);
+    expect(reader.read_document(doc), "the trace is JSON");
+    expect(doc.kind==json::object && doc.members["traceEvents"].kind==json::array, "the trace has a list of events");
+    const std::set<std::string> known = {"define_param", "define_schema", "load_schema", "parse_params", "convert", "validate_choice",
+                                         "check_constraints", "print_help", "layout_params", "layout_paragraph", "flush_output"};
+    std::set<std::string>                         seen;
+    std::map<double, std::vector<const json*>>    by_thread;
+    for(const json& e: doc.members["traceEvents"].items) {
+        if(e.kind!=json::object) { expect(false, "an event is an object"); continue; }
+        const std::map<std::string, json>& m = e.members;
+        const std::string name = m.count("name") ? m.at("name").str : "";
+        expect(known.count(name)==1, "known event name \"" + name + "\"");
+        expect(m.count("ph") && m.at("ph").str=="X", "complete event " + name);
+        expect(m.count("ts") && m.at("ts").kind==json::number && m.at("ts").num>=0, "time of " + name);
+        expect(m.count("dur") && m.at("dur").kind==json::number && m.at("dur").num>=0, "duration of " + name);
+        expect(m.count("tid") && m.at("tid").kind==json::number && m.at("tid").num>0, "thread of " + name);
+        seen.insert(name);
+        if(m.count("tid")) by_thread[m.at("tid").num].push_back(&e);
+    }
+    for(const std::string& name: known) expect(seen.count(name)==1, "an event " + name + " was recorded");
+
+    /* events of a thread are intervals that nest, a child starts and ends inside its parent */
+    std::size_t layout_threads = 0;
+    for(std::pair<const double, std::vector<const json*>>& t: by_thread) {
+        std::vector<std::pair<double, double>> spans;
+        bool lays_out = false;
+        for(const json* e: t.second) {
+            const double ts = e->members.at("ts").num, dur = e->members.at("dur").num;
+            spans.push_back(std::make_pair(ts, ts + dur));
+            if(e->members.at("name").str=="layout_params") lays_out = true;
+        }
+        if(lays_out) layout_threads++;
+        std::sort(spans.begin(), spans.end(), [] (const std::pair<double, double>& a, const std::pair<double, double>& b) {
+            return a.first<b.first || (a.first==b.first && a.second>b.second);
+        });
+        std::vector<double> open;
+        for(const std::pair<double, double>& s: spans) {
+            while(!open.empty() && open.back()<=s.first) open.pop_back();
+            if(!open.empty() && s.second>open.back() + 0.001) { expect(false, "events of a thread overlap without nesting"); break; }
+            open.push_back(s.second);
+        }
+    }
+    expect(layout_threads==2, "the params were laid out by 2 threads");
+
+    if(failures!=0) {
+        std::cerr << failures << " failures" << std::endl;
+        return 1;
+    }
+    std::cout << "ok, " << doc.members["traceEvents"].items.size() << " events" << std::endl;
+    return 0;
+}
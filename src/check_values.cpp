@@ -0,0 +1,663 @@
+/*
+
+************************************************************************************************
+
+LICENSE
+
+    Help80 - Copyright (C) 2016 - Olivier Deiss - olivier.deiss@gmail.com
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+************************************************************************************************
+
+    Checks of the definitions and of the rules on values: each case defines parameters, then
+    checks the help menu, or parses a command line and checks that it is accepted with the
+    expected values, or refused with the expected exception.
+
+*/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "Parameters.hpp"
+
+static int failures = 0;
+
+static void expect(const bool ok, const std::string& what) {
+    if(!ok) { std::cerr << "FAILED: " << what << std::endl; failures++; }
+}
+
+/* true if parsing the command throws an exception of type E */
+template<typename E>
+static bool refused(Parameters& p, const std::string& command) {
+    try             { p.parse_params(command); }
+    catch(const E&) { return true; }
+    catch(...)        { return false; }
+    return false;
+}
+
+static const Parameters::config p_c {40, 80, 3, 1, 27, 5, 3, 2, Parameters::lang_us};
+static char                     prog[] = "check";
+static char*                    args[] = {prog};
+
+/* a range applies to every accumulated occurrence, not only to the last one */
+static void range_and_accumulate() {
+    Parameters p(1, args, p_c);
+    p.define_num_str_param<int>("n", {"value"}, {0}, "Accumulated and bounded.");
+    p.set_occurrence_policy("n", Parameters::occurrence_accumulate);
+    p.set_range<int>("n", 0, 10);
+    expect(refused<Parameters::ValueOutOfBoundsException>(p, "--n 999 --n 5"), "range, first occurrence out of bounds");
+    expect(refused<Parameters::ValueOutOfBoundsException>(p, "--n 5 --n 999"), "range, last occurrence out of bounds");
+    p.parse_params("--n 3 --n 5 --n 10");
+    const Parameters::Span<int> n = p.num_vals<int>("n");
+    expect(n.size()==3 && n[0]==3 && n[1]==5 && n[2]==10, "range, occurrences in bounds");
+}
+
+/* a range applies to every positional arg */
+static void range_and_positional() {
+    Parameters p(1, args, p_c);
+    p.define_positional<int>("sizes", "size", 1, Parameters::unbounded, "Positional and bounded.");
+    p.set_range<int>("sizes", 0, 100);
+    expect(refused<Parameters::ValueOutOfBoundsException>(p, "999"),    "positional range, single arg out of bounds");
+    expect(refused<Parameters::ValueOutOfBoundsException>(p, "999 5"),  "positional range, first arg out of bounds");
+    expect(refused<Parameters::ValueOutOfBoundsException>(p, "5 -5"),   "positional range, last arg out of bounds");
+    p.parse_params("0 42 100");
+    const Parameters::Span<int> sizes = p.num_vals<int>("sizes");
+    expect(sizes.size()==3 && sizes[0]==0 && sizes[1]==42 && sizes[2]==100, "positional range, args in bounds");
+}
+
+/* a schema file with CRLF line endings reads like the same file with LF */
+static void crlf_schema() {
+    const std::string path = "check_values.schema";
+    {
+        std::ofstream out(path, std::ios::binary);
+        out << "help80-schema 1\r\n\r\n# comment\r\nvalue\twidth\tint\tvalue\t80\t1\tWidth.\r\n\r\nparam\tverbose\tPrints more.\r\n";
+    }
+    Parameters p(1, args, p_c);
+    bool loaded = true;
+    try        { p.load_schema(path); }
+    catch(...) { loaded = false; }
+    std::remove(path.c_str());
+    expect(loaded, "CRLF schema is loaded");
+    if(!loaded) return;
+    p.parse_params("--width 120 --verbose");
+    expect(p.num_val<int>("width")==120 && p.is_spec("verbose"), "CRLF schema entries");
+    std::ostringstream out;
+    Parameters::PlainRenderer r(out);
+    p.print_help(r, false, false);
+    expect(out.str().find('\r')==std::string::npos, "no CR in the help menu of a CRLF schema");
+}
+
+/* a description in an array is copied up to its NUL, a literal() is pointed to up to its NUL */
+static void char_array_descriptions() {
+    Parameters p(1, args, p_c);
+    {
+        char buffer[64];
+        std::memset(buffer, 'Z', sizeof(buffer));
+        std::strcpy(buffer, "Short desc.");
+        p.define_param("buffer", buffer);
+        std::memset(buffer, 'Y', sizeof(buffer));
+    }
+    {
+        char local[32];
+        std::memset(local, 'X', sizeof(local));
+        std::strcpy(local, "Local desc.");
+        const char (&desc)[32] = local;
+        p.define_param("local", desc);
+        std::memset(local, 'W', sizeof(local));
+    }
+    static const char padded[32] = "Padded desc.";
+    p.define_param("padded", Parameters::literal(padded));
+    static const char pointed[] = "Pointed desc.";
+    p.define_param("pointed", Parameters::literal(pointed));
+    std::ostringstream out;
+    Parameters::PlainRenderer r(out);
+    p.print_help(r, false, false);
+    const std::string help = out.str();
+    expect(help.find("Short desc.\n")!=std::string::npos, "char buffer description is copied");
+    expect(help.find("Local desc.\n")!=std::string::npos, "const char array description is copied");
+    expect(help.find("Padded desc.\n")!=std::string::npos, "literal description stops at its NUL");
+    expect(help.find("Pointed desc.\n")!=std::string::npos, "literal description");
+    expect(help.find_first_of("WXYZ")==std::string::npos, "no chars after the NUL of a description");
+}
+
+/* each overload of parse_params starts from the default values, the subcommand and the occurrences are forgotten */
+static void parse_from_defaults() {
+    char        n_arg[]   = "--n";
+    char        n_val[]   = "5";
+    char        run_arg[] = "run";
+    char* const argv[]    = {prog, n_arg, n_val, run_arg};
+    Parameters  p(4, argv, p_c);
+    p.define_num_str_param<int>("n", {"value"}, {1}, "Accumulated.");
+    p.set_occurrence_policy("n", Parameters::occurrence_accumulate);
+    p.define_param("flag", "A flag.");
+    p.define_subcommand("run", "Runs.", [] (Parameters&) {});
+    p.parse_params("--flag --n 7");
+    p.parse_params();
+    expect(p.num_vals<int>("n").size()==1 && p.num_val<int>("n")==5 && !p.is_spec("flag") && p.has_subcommand(), "argv after a command");
+    p.parse_params();
+    expect(p.num_vals<int>("n").size()==1 && p.occurrences("n")==1 && p.has_subcommand(), "argv parsed twice");
+    const std::vector<std::string> range = {"--flag"};
+    p.parse_params(range.begin(), range.end());
+    expect(p.num_val<int>("n")==1 && !p.is_spec("n") && p.is_spec("flag") && !p.has_subcommand(), "range after argv");
+    p.parse_params("");
+    expect(!p.is_spec("flag") && !p.has_subcommand(), "empty command after a range");
+}
+
+/* defines one param of each kind, and a subcommand */
+static void define_all(Parameters& p) {
+    p.define_num_str_param<int>("n", {"first", "second"}, {0, 0}, "Integers.");
+    p.define_num_str_param<float>("ratio", {"value"}, {0.5f}, "A float.");
+    p.define_num_str_param<std::string>("name", {"text"}, {"none"}, "Strings.");
+    p.set_occurrence_policy("name", Parameters::occurrence_accumulate);
+    p.define_num_str_param<bool>("on", {"bool"}, {false}, "A bool.");
+    p.define_choice_param("mode", "mode", "fast", {{"fast", "Fast."}, {"slow", "Slow."}}, "A choice.");
+    p.define_unit_param<long long>("size", {"bytes"}, Parameters::unit_bytes, {0}, "A size.");
+    p.define_param("flag", "A flag.");
+    p.define_positional<int>("rest", "value", 0, Parameters::unbounded, "Positional values.");
+    p.define_subcommand("run", "Runs.", [] (Parameters& sub) {
+        sub.define_num_str_param<int>("jobs", {"n"}, {1}, "Jobs.");
+    });
+}
+
+/* the values and the subcommand attached from a snapshot are the parsed ones */
+static void snapshot_round_trip() {
+    Parameters p(1, args, p_c);
+    define_all(p);
+    p.parse_params("--n 3 -4 --ratio 0.25 --name a --name 'b c' --on true --mode slow --size 4KiB 7 8 9 run --jobs 6");
+    const std::string blob = p.snapshot();
+    Parameters q(1, args, p_c);
+    define_all(q);
+    q.attach_snapshot(blob.data(), blob.size());
+    expect(q.num_val<int>("n", 1)==3 && q.num_val<int>("n", 2)==-4, "round trip of int values");
+    expect(q.num_val<float>("ratio")==0.25f, "round trip of a float");
+    const Parameters::Span<std::string> names = q.str_vals("name");
+    expect(names.size()==2 && names[0]=="a" && names[1]=="b c" && q.occurrences("name")==2, "round trip of accumulated strings");
+    expect(q.num_val<bool>("on") && q.cho_val("mode")=="slow" && q.cho_index("mode")==1, "round trip of a bool and a choice");
+    expect(q.num_val<long long>("size")==4096, "round trip of a unit value");
+    const Parameters::Span<int> rest = q.num_vals<int>("rest");
+    expect(rest.size()==3 && rest[0]==7 && rest[2]==9, "round trip of positional values");
+    expect(q.is_spec("n") && !q.is_spec("flag"), "round trip of is_spec");
+    expect(q.has_subcommand() && q.subcommand_name()=="run" && q.subcommand().num_val<int>("jobs")==6, "round trip of the subcommand");
+    expect(q.snapshot()==blob, "snapshot of attached values");
+    /* without a subcommand, the one attached before is forgotten */
+    Parameters r(1, args, p_c);
+    define_all(r);
+    r.parse_params("--flag");
+    const std::string plain = r.snapshot();
+    q.attach_snapshot(plain.data(), plain.size());
+    expect(!q.has_subcommand() && q.is_spec("flag") && !q.is_spec("n"), "snapshot without a subcommand");
+}
+
+/* params matching every word are printed by score: names, then choices, values names and descriptions */
+static void search_ranking() {
+    Parameters p(1, args, p_c);
+    p.define_param("verbose", "Prints more.");
+    p.define_num_str_param<int>("size", {"bytes"}, {0}, "Cache size.");
+    p.define_choice_param("mode", "mode", "direct", {{"direct", "Reads the disk."}, {"cached", "Reads through a cache."}}, "Read mode.");
+    p.define_num_str_param<std::string>("output", {"cache"}, {"out"}, "Where to write.");
+    p.define_param("cachedir", "Where to keep files.");
+    p.define_param("cache", "Keeps files in memory, with a size limit.");
+    const std::vector<std::string> ranked = {"--cache ", "--cachedir ", "--mode ", "--output ", "--size "};
+    std::ostringstream out;
+    Parameters::PlainRenderer r(out);
+    expect(p.search_help(r, "cache")==5, "params matching a word");
+    std::string found = out.str();
+    bool in_order = true;
+    for(std::size_t i=1 ; i<ranked.size() ; i++) in_order = in_order && found.find(ranked[i-1])<found.find(ranked[i]) && found.find(ranked[i])!=std::string::npos;
+    expect(in_order, "name, then partial name, then choice and value name in definition order, then description");
+    expect(found.find("--verbose")==std::string::npos, "params that don't match are not printed");
+    expect(found.find("Reads through a cache.")!=std::string::npos && found.find("Reads the disk.")==std::string::npos, "only the matching choices are printed");
+    /* every word must match, a param can win with another word */
+    out.str("");
+    expect(p.search_help(r, "SIZE cach")==2, "params matching all the words");
+    found = out.str();
+    expect(found.find("--size ")<found.find("--cache "), "whole name beats partial name");
+    out.str("");
+    expect(p.search_help(r, "zzz")==0 && out.str().find("No parameter matches \"zzz\".")!=std::string::npos, "no match");
+    /* a saved index gives the same results, and is refused for other params */
+    const std::string path = "check_values.search";
+    p.write_search_index(path);
+    Parameters q(1, args, p_c);
+    q.define_param("verbose", "Prints more.");
+    q.define_num_str_param<int>("size", {"bytes"}, {0}, "Cache size.");
+    q.define_choice_param("mode", "mode", "direct", {{"direct", "Reads the disk."}, {"cached", "Reads through a cache."}}, "Read mode.");
+    q.define_num_str_param<std::string>("output", {"cache"}, {"out"}, "Where to write.");
+    q.define_param("cachedir", "Where to keep files.");
+    q.define_param("cache", "Keeps files in memory, with a size limit.");
+    expect(q.read_search_index(path), "saved search index");
+    std::ostringstream saved;
+    Parameters::PlainRenderer saved_r(saved);
+    out.str("");
+    q.search_help(saved_r, "cache");
+    p.search_help(r, "cache");
+    expect(saved.str()==out.str(), "search from a saved index");
+    q.define_param("other", "Another cache.");
+    expect(!q.read_search_index(path), "saved index of other params");
+    std::remove(path.c_str());
+}
+
+/* a type of the program, read as "major.minor" */
+struct version {
+    int major;
+    int minor;
+    bool operator<(const version& v) const { return major<v.major || (major==v.major && minor<v.minor); }
+    bool operator==(const version& v) const { return major==v.major && minor==v.minor; }
+};
+
+template<> struct Parameters::ParseTraits<version> {
+    static const Parameters::PARSE parse(const char* const first, const char* const, version& value) {
+        char* stop = nullptr;
+        const long major = std::strtol(first, &stop, 10);
+        if(stop==first || *stop!='.') return Parameters::parse_invalid;
+        const char* const minor_first = stop+1;
+        const long minor = std::strtol(minor_first, &stop, 10);
+        if(stop==minor_first || *stop!=0) return Parameters::parse_invalid;
+        if(major<0 || minor<0 || major>999 || minor>999) return Parameters::parse_out_of_range;
+        value.major = static_cast<int>(major);
+        value.minor = static_cast<int>(minor);
+        return Parameters::parse_ok;
+    }
+    static const std::string format(const version& value) { return std::to_string(value.major) + "." + std::to_string(value.minor); }
+    static const char* name() { return "version"; }
+};
+
+/* a type with its own ParseTraits is read, bound, checked, printed and saved like a built-in one */
+static void custom_type() {
+    version bound = {0, 0};
+    Parameters p(1, args, p_c);
+    p.define_num_str_param<version>("from", {"version"}, {version{1, 2}}, "First version.", true);
+    p.define_num_str_param<version>("to", "version", version{2, 0}, "Last version.", bound);
+    p.define_positional<version>("other", "version", 0, Parameters::unbounded, "Other versions.");
+    p.set_range<version>("to", version{1, 0}, version{9, 99});
+    expect(p.num_val<version>("from")==version{1, 2} && bound==version{2, 0}, "default values of a custom type");
+    p.parse_params("--from 3.14 --to 4.1 5.0 6.7");
+    expect(p.num_val<version>("from")==version{3, 14} && bound==version{4, 1}, "custom values");
+    const Parameters::Span<version> others = p.num_vals<version>("other");
+    expect(others.size()==2 && others[1]==version{6, 7}, "positional custom values");
+    std::string what;
+    try                                              { p.parse_params("--from 3"); }
+    catch(const Parameters::InvalidValueException& e) { what = e.what(); }
+    expect(what.find("version")!=std::string::npos && what.find("\"3\"")!=std::string::npos, "invalid custom value names its type");
+    expect(refused<Parameters::InvalidValueException>(p, "--from 1000.0"), "custom value out of its own range");
+    expect(refused<Parameters::InvalidValueException>(p, "--from 1.2x"), "custom value with trailing chars");
+    expect(refused<Parameters::ValueOutOfBoundsException>(p, "--to 10.0"), "range of a custom type");
+    /* saved byte by byte, printed with format */
+    p.parse_params("--from 7.8 --to 3.3");
+    const std::string blob = p.snapshot();
+    p.parse_params("");
+    p.attach_snapshot(blob.data(), blob.size());
+    expect(p.num_val<version>("from")==version{7, 8} && bound==version{3, 3}, "snapshot of custom values");
+    std::ostringstream out;
+    Parameters::PlainRenderer r(out);
+    p.print_help(r, false, false);
+    expect(out.str().find("1.2")!=std::string::npos, "default of a custom type printed with format");
+}
+
+/* a value with a unit must be a whole number of base units that fits in the type */
+static void unit_limits() {
+    Parameters p(1, args, p_c);
+    p.define_unit_param<long long>("size", {"bytes"}, Parameters::unit_bytes, {0}, "Size.");
+    p.define_unit_param<unsigned long long>("usize", {"bytes"}, Parameters::unit_bytes, {4ull << 30}, "Unsigned size.", true);
+    p.define_unit_param<int>("timeout", {"duration"}, Parameters::unit_milliseconds, {90000}, "Timeout.", true);
+    p.define_unit_param<int>("count", {"n"}, Parameters::unit_count, {0}, "Count.");
+    p.parse_params("--size 1.5KiB --usize 8EiB --timeout 1.5s --count 1.5k");
+    expect(p.num_val<long long>("size")==1536 && p.num_val<unsigned long long>("usize")==(1ull << 63), "sizes with units");
+    expect(p.num_val<int>("timeout")==1500 && p.num_val<int>("count")==1500, "duration and count with units");
+    p.parse_params("--size 1KB --usize 1k --timeout 2000us --count 1K");
+    expect(p.num_val<long long>("size")==1000 && p.num_val<unsigned long long>("usize")==1024, "decimal and binary sizes");
+    expect(p.num_val<int>("timeout")==2 && p.num_val<int>("count")==1000, "whole duration in a smaller unit");
+    p.parse_params("--size -1.5KiB --timeout 1m");
+    expect(p.num_val<long long>("size")==-1536 && p.num_val<int>("timeout")==60000, "negative size and minutes");
+    p.parse_params("--size 7EiB --timeout 1d");
+    expect(p.num_val<long long>("size")==7ll << 60 && p.num_val<int>("timeout")==86400000, "largest units that fit");
+    expect(refused<Parameters::UnitExpectedException>(p, "--size 0.5B"), "half a byte");
+    expect(refused<Parameters::UnitExpectedException>(p, "--timeout 1500us"), "1500us for milliseconds");
+    expect(refused<Parameters::UnitExpectedException>(p, "--timeout 1ns"), "1ns for milliseconds");
+    expect(refused<Parameters::UnitExpectedException>(p, "--size 1XB"), "unknown unit");
+    expect(refused<Parameters::UnitExpectedException>(p, "--count 1KB"), "size unit for a count");
+    expect(refused<Parameters::ValueOutOfRangeException<long long>>(p, "--size 8EiB"), "8EiB in a long long");
+    expect(refused<Parameters::ValueOutOfRangeException<unsigned long long>>(p, "--usize 16EiB"), "16EiB in an unsigned long long");
+    expect(refused<Parameters::ValueOutOfRangeException<int>>(p, "--timeout 30d"), "30 days of milliseconds in an int");
+    expect(refused<Parameters::ValueOutOfRangeException<unsigned long long>>(p, "--usize -1B"), "negative unsigned size");
+    /* defaults are printed in the largest unit that divides them */
+    std::ostringstream out;
+    Parameters::PlainRenderer r(out);
+    p.print_help(r, false, false);
+    const std::string help = out.str();
+    expect(help.find("4GiB")!=std::string::npos && help.find("90s")!=std::string::npos, "defaults printed with units");
+}
+
+/* bound variables follow every parse, and go back to the defaults on a reparse */
+static void bound_variables() {
+    enum class MODE {fast, slow};
+    int                width   = 0;
+    std::vector<int>   point;
+    bool               verbose = true;
+    std::string        color;
+    MODE               mode    = MODE::slow;
+    long long          size    = 0;
+    Parameters p(1, args, p_c);
+    p.define_num_str_param<int>("width", "value", 80, "Width.", width);
+    p.define_num_str_param<int>("point", {"x", "y"}, {1, 2}, "Point.", point);
+    p.define_param("verbose", "Prints more.", verbose);
+    p.define_choice_param("color", "color", "red", {{"red", "Red."}, {"blue", "Blue."}}, "Color.", color);
+    p.define_choice_param("mode", "mode", "fast", {{"fast", "Fast."}, {"slow", "Slow."}}, "Mode.", mode);
+    p.define_unit_param<long long>("size", "bytes", Parameters::unit_bytes, 1024, "Size.", size);
+    /* defaults are written at definition */
+    expect(width==80 && point==std::vector<int>({1, 2}) && !verbose && color=="red" && mode==MODE::fast && size==1024, "bound defaults");
+    p.parse_params("--width 100 --point 3 4 --verbose --color blue --mode slow --size 2KiB");
+    expect(width==100 && point==std::vector<int>({3, 4}) && verbose && color=="blue" && mode==MODE::slow && size==2048, "bound values");
+    expect(p.num_val<int>("width")==100 && p.cho_index("mode")==1, "accessors of bound params");
+    /* a new parse starts from the defaults, even if the variables were changed */
+    width = 7;
+    point[0] = 7;
+    p.parse_params("--point 5 6");
+    expect(width==80 && point==std::vector<int>({5, 6}) && !verbose && color=="red" && mode==MODE::fast && size==1024, "bound values after a reparse");
+    p.parse_params("");
+    expect(point==std::vector<int>({1, 2}), "bound values back to defaults");
+    /* reparse writes them too, and attach_snapshot restores them */
+    const char* const line[] = {prog, "--width", "120", "--mode", "slow"};
+    p.reparse(5, line);
+    expect(width==120 && mode==MODE::slow && !verbose, "bound values of reparse");
+    p.parse_params("--verbose --size 1MiB");
+    const std::string blob = p.snapshot();
+    p.parse_params("");
+    p.attach_snapshot(blob.data(), blob.size());
+    expect(verbose && size==1048576 && width==80 && mode==MODE::fast, "bound values of attach_snapshot");
+}
+
+/* a choice is found by its whole name, its position is given by cho_index and cho_enum */
+static void choice_index() {
+    enum class LEVEL {low, medium, high};
+    Parameters::vec_choices many;
+    for(int i=0 ; i<40 ; i++) many.push_back(std::make_pair("c" + std::to_string(i), "Choice."));
+    Parameters p(1, args, p_c);
+    p.define_choice_param("level", "level", "medium", {{"low", "Low."}, {"medium", "Medium."}, {"high", "High."}}, "A level.");
+    p.define_choice_param("many", "choice", "c0", many, "Many choices.");
+    p.define_num_str_param<int>("n", {"value"}, {0}, "A number.");
+    p.parse_params("");
+    expect(p.cho_index("level")==1 && p.cho_enum<LEVEL>("level")==LEVEL::medium && p.cho_val("level")=="medium", "default choice");
+    p.parse_params("--level high");
+    expect(p.cho_index("level")==2 && p.cho_enum<LEVEL>("level")==LEVEL::high && p.cho_val("level")=="high", "given choice");
+    bool all_found = true;
+    for(int i=0 ; i<40 ; i++) {
+        p.parse_params("--many c" + std::to_string(i));
+        all_found = all_found && p.cho_index("many")==static_cast<std::size_t>(i) && p.cho_val("many")=="c" + std::to_string(i);
+    }
+    expect(all_found, "every choice of many");
+    expect(refused<Parameters::UnknownChoiceException>(p, "--level hig"), "prefix of a choice");
+    expect(refused<Parameters::UnknownChoiceException>(p, "--level High"), "choice with another case");
+    expect(refused<Parameters::UnknownChoiceException>(p, "--many c40"), "unknown choice");
+    /* a bound enum follows the choice */
+    LEVEL level = LEVEL::low;
+    std::string name;
+    Parameters q(1, args, p_c);
+    q.define_choice_param("level", "level", "low", {{"low", "Low."}, {"medium", "Medium."}, {"high", "High."}}, "A level.", level);
+    q.define_choice_param("mode", "mode", "fast", {{"fast", "Fast."}, {"slow", "Slow."}}, "A mode.", name);
+    q.parse_params("--level medium --mode slow");
+    expect(level==LEVEL::medium && name=="slow", "bound choices");
+    /* wrong uses */
+    bool thrown = false;
+    try                                                  { p.cho_index("n"); }
+    catch(const Parameters::DynamicCastFailedException&) { thrown = true; }
+    expect(thrown, "cho_index of a param that is not a choice");
+    thrown = false;
+    try                                                   { p.cho_index("none"); }
+    catch(const Parameters::UndefinedParameterException&) { thrown = true; }
+    expect(thrown, "cho_index of an undefined param");
+    thrown = false;
+    try                                              { p.define_choice_param("bad", "bad", "none", {{"one", "One."}}, "Bad default."); }
+    catch(const Parameters::UnknownChoiceException&) { thrown = true; }
+    expect(thrown, "default that is not a choice");
+}
+
+/* what the function prints on the standard output */
+template<typename F>
+static std::string printed(F f) {
+    std::ostringstream     out;
+    std::streambuf* const  old = std::cout.rdbuf(out.rdbuf());
+    f();
+    std::cout.rdbuf(old);
+    return out.str();
+}
+
+/* complete() and complete_from_index answer a query with the same candidates */
+static void completion_queries() {
+    const std::string path = "check_values.index";
+    {
+        Parameters p(1, args, p_c);
+        define_all(p);
+        p.write_completion_index(path);
+    }
+    const std::vector<std::pair<std::vector<const char*>, std::string>> queries = {
+        {{"--r"},                "--ratio\n"},
+        {{"--mode", ""},         "fast\nslow\n"},
+        {{"--mode", "s"},        "slow\n"},
+        {{"--n", "3", ""},       "<second>\n"},
+        {{"--size", ""},         "<bytes>\n"},
+        {{"r"},                  "run\n"},
+        {{"--x"},                ""},
+        {{"--on", "1", "--f"},   "--flag\n"},
+    };
+    for(const std::pair<std::vector<const char*>, std::string>& q: queries) {
+        std::vector<const char*> words = {prog, "--__complete"};
+        words.insert(words.end(), q.first.begin(), q.first.end());
+        const int nb_words = static_cast<int>(words.size());
+        std::string what = "completion of";
+        for(const char* word: q.first) what += std::string(" \"") + word + "\"";
+        Parameters p(nb_words, words.data(), p_c);
+        define_all(p);
+        bool answered = false;
+        expect(printed([&] { answered = p.complete(); })==q.second && answered, what);
+        expect(printed([&] { answered = Parameters::complete_from_index(nb_words, words.data(), path); })==q.second && answered, what + " from the index");
+    }
+    /* every name but the positional slots, parameters and subcommands sorted together */
+    const char* const all[] = {prog, "--__complete", ""};
+    Parameters p(3, all, p_c);
+    define_all(p);
+    expect(printed([&] { p.complete(); })=="--flag\n--mode\n--n\n--name\n--on\n--ratio\n--size\nrun\n", "completion of every name");
+    /* not a query, or no index: the program goes on */
+    const char* const line[] = {prog, "--flag"};
+    Parameters q(2, line, p_c);
+    define_all(q);
+    expect(!q.complete() && !Parameters::complete_from_index(2, line, path), "a command line is not a completion query");
+    std::remove(path.c_str());
+    expect(!Parameters::complete_from_index(3, all, path), "no completion without an index");
+}
+
+/* only the invoked subcommand is defined, it parses the rest of the line and has its own help */
+static void subcommand_dispatch() {
+    int nb_run = 0, nb_build = 0;
+    Parameters p(1, args, p_c);
+    p.define_param("verbose", "Prints more.");
+    p.define_subcommand("run", "Runs the program.", [&nb_run] (Parameters& sub) {
+        nb_run++;
+        sub.define_num_str_param<int>("jobs", {"n"}, {1}, "Number of jobs.");
+    });
+    p.define_subcommand("build", "Builds the program.", [&nb_build] (Parameters& sub) {
+        nb_build++;
+        sub.define_param("release", "Optimized build.");
+    });
+    p.parse_params("run --jobs 3 --verbose -- a b");
+    expect(nb_run==1 && nb_build==0, "only the invoked subcommand is defined");
+    expect(p.has_subcommand() && p.subcommand_name()=="run" && p.subcommand().num_val<int>("jobs")==3, "subcommand values");
+    expect(p.is_spec("verbose"), "global param after the subcommand");
+    expect(p.subcommand().passthrough().size()==2 && std::string(p.subcommand().passthrough()[1])=="b", "passthrough after the subcommand");
+    expect(refused<Parameters::UnknownParameterException>(p, "build --jobs 2") && nb_build==1, "param of another subcommand");
+    expect(refused<Parameters::UnknownSubcommandException>(p, "walk"), "unknown subcommand");
+    expect(refused<Parameters::UnknownParameterException>(p, "--jobs 2 run"), "param of a subcommand before it");
+    bool thrown = false;
+    p.parse_params("--verbose");
+    try                                                  { p.subcommand(); }
+    catch(const Parameters::UnknownSubcommandException&) { thrown = true; }
+    expect(thrown && !p.has_subcommand() && nb_run==1, "no subcommand invoked");
+    /* the main menu lists the subcommands in definition order, the subcommand's lists its params */
+    std::ostringstream out;
+    Parameters::PlainRenderer r(out);
+    p.print_help(r, false, false);
+    const std::string help = out.str();
+    const std::size_t commands = help.find("COMMANDS:\n");
+    expect(commands!=std::string::npos && help.find("--verbose")<commands, "subcommands are listed after the params");
+    expect(help.find("build", commands)!=std::string::npos && help.find("run", commands)<help.find("build", commands), "subcommands in definition order");
+    expect(help.find("Runs the program.")!=std::string::npos && help.find("--jobs")==std::string::npos, "subcommand params are not in the main menu");
+    p.parse_params("run");
+    std::ostringstream sub_out;
+    Parameters::PlainRenderer sub_r(sub_out);
+    p.subcommand().print_help(sub_r, false, false);
+    const std::string sub_help = sub_out.str();
+    expect(sub_help.find("--jobs")!=std::string::npos && sub_help.find("Number of jobs.")!=std::string::npos, "subcommand menu");
+    expect(sub_help.find("COMMANDS:")==std::string::npos && sub_help.find("--release")==std::string::npos, "subcommand menu has only its params");
+}
+
+/* after a subcommand, its own params and the main command's are completed */
+static void subcommand_completion() {
+    const std::vector<std::pair<std::vector<const char*>, std::string>> queries = {
+        {{"run", "--j"},                   "--jobs\n"},
+        {{"run", "--jobs", ""},            "<n>\n"},
+        {{"run", "--r"},                   "--ratio\n"},
+        {{"run", "--mode", ""},            "fast\nslow\n"},
+        {{"--name", "run", "--j"},         ""},
+        {{"--n", "1", "2", "run", "--j"},  "--jobs\n"},
+    };
+    for(const std::pair<std::vector<const char*>, std::string>& q: queries) {
+        std::vector<const char*> words = {prog, "--__complete"};
+        words.insert(words.end(), q.first.begin(), q.first.end());
+        std::string what = "completion of";
+        for(const char* word: q.first) what += std::string(" \"") + word + "\"";
+        Parameters p(static_cast<int>(words.size()), words.data(), p_c);
+        define_all(p);
+        expect(printed([&] { p.complete(); })==q.second, what);
+    }
+}
+
+/* the scripts call the program with the words typed so far */
+static void completion_scripts() {
+    const char* const bash[] = {prog, "--__complete_script", "bash"};
+    Parameters p(3, bash, p_c);
+    const std::string script = printed([&] { p.complete(); });
+    expect(script.find("check --__complete \"${COMP_WORDS[@]:1:$COMP_CWORD}\"")!=std::string::npos, "bash script calls the program");
+    expect(script.find("complete -o default -F _check_complete check\n")!=std::string::npos, "bash script is registered");
+    const char* const zsh[] = {prog, "--__complete_script", "zsh"};
+    Parameters q(3, zsh, p_c);
+    const std::string zscript = printed([&] { q.complete(); });
+    expect(zscript.compare(0, 15, "#compdef check\n")==0, "zsh script starts with #compdef");
+    expect(zscript.find("check --__complete \"${(@)words[2,CURRENT]}\"")!=std::string::npos, "zsh script calls the program");
+    expect(zscript.find("compdef _check_complete check\n")!=std::string::npos, "zsh script is registered");
+}
+
+/* a bool byte other than 0 or 1, or an unknown subcommand, is refused and changes nothing */
+static void snapshot_corrupt() {
+    Parameters p(1, args, p_c);
+    p.define_num_str_param<bool>("on", {"bool"}, {false}, "A bool.");
+    p.parse_params("--on true");
+    std::string blob = p.snapshot();
+    /* header, then is_defined and occurrences, then the value */
+    blob[4 + 4 + 8 + 4 + 1 + 4] = 2;
+    p.parse_params("");
+    bool refused = false;
+    try                                                { p.attach_snapshot(blob.data(), blob.size()); }
+    catch(const Parameters::InvalidSnapshotException&) { refused = true; }
+    expect(refused && !p.num_val<bool>("on") && !p.is_spec("on"), "bool byte other than 0 or 1");
+    Parameters q(1, args, p_c);
+    define_all(q);
+    q.parse_params("run --jobs 2");
+    std::string with_sub = q.snapshot();
+    const std::size_t at = with_sub.rfind("run");
+    expect(at!=std::string::npos, "subcommand name in a snapshot");
+    if(at!=std::string::npos) with_sub[at] = 'x';
+    q.parse_params("--n 1 1");
+    refused = false;
+    try                                                { q.attach_snapshot(with_sub.data(), with_sub.size()); }
+    catch(const Parameters::InvalidSnapshotException&) { refused = true; }
+    expect(refused && !q.has_subcommand() && q.num_val<int>("n")==1, "unknown subcommand in a snapshot");
+}
+
+/* a guard needs published values, and gives its slot back when it cannot get them */
+static void guard_before_publish() {
+    Parameters p(1, args, p_c);
+    p.define_num_str_param<int>("n", {"value"}, {4}, "Published.");
+    for(int k=0 ; k<300 ; k++) {
+        bool thrown = false;
+        try                                                 { Parameters::ReadGuard guard(p); }
+        catch(const Parameters::NothingPublishedException&) { thrown = true; }
+        if(!thrown) { expect(false, "guard before the first publish"); return; }
+    }
+    /* more refused guards than slots, so slots were given back */
+    p.publish();
+    Parameters::ReadGuard guard(p);
+    expect(guard->num_val<int>("n")==4, "guard after the first publish");
+}
+
+/* the menu laid out by several threads is the menu laid out by the calling thread */
+static void threaded_layout() {
+    Parameters p(1, args, p_c);
+    for(int k=0 ; k<60 ; k++) {
+        const std::string name = "p" + std::to_string(k);
+        if(k%20==0) p.insert_subsection("Section " + std::to_string(k/20));
+        if(k%3==0)      p.define_num_str_param<int>(name, {"value"}, {k}, "Value $_1 of $_0, number " + std::to_string(k) + ".", true);
+        else if(k%3==1) p.define_choice_param(name, "mode", "a", {{"a", "First."}, {"b", "Second."}}, "Choice " + std::to_string(k) + ".", true);
+        else            p.define_param(name, "Flag " + std::to_string(k) + ", see $p(p0).");
+        if(k%3==0)      p.set_range<int>(name, 0, 100);
+        if(k%7==1)      p.add_conflicts(name, {"p0"});
+    }
+    std::string single;
+    { Parameters::PlainRenderer r(single); p.print_help(r, false, false); }
+    const std::size_t jobs[] = {2, 3, 7, 0};
+    for(const std::size_t j: jobs) {
+        p.set_layout_jobs(j, 1);
+        std::string threaded;
+        Parameters::PlainRenderer r(threaded);
+        p.print_help(r, false, false);
+        expect(threaded==single, "menu laid out by " + std::to_string(j) + " jobs");
+    }
+    /* with fewer params than the minimum per thread, there is one thread, and the same menu */
+    p.set_layout_jobs(4);
+    std::string few;
+    { Parameters::PlainRenderer r(few); p.print_help(r, false, false); }
+    expect(few==single, "menu of a few params with jobs");
+}
+
+int main() {
+    char_array_descriptions();
+    range_and_accumulate();
+    range_and_positional();
+    crlf_schema();
+    threaded_layout();
+    guard_before_publish();
+    parse_from_defaults();
+    snapshot_round_trip();
+    snapshot_corrupt();
+    completion_queries();
+    completion_scripts();
+    subcommand_completion();
+    subcommand_dispatch();
+    choice_index();
+    bound_variables();
+    unit_limits();
+    custom_type();
+    search_ranking();
+    if(failures!=0) {
+        std::cerr << failures << " failures" << std::endl;
+        return 1;
+    }
+    std::cout << "ok" << std::endl;
+    return 0;
+}
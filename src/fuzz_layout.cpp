@@ -0,0 +1,445 @@
+/*
+
+************************************************************************************************
+
+LICENSE
+
+    Help80 - Copyright (C) 2016 - Olivier Deiss - olivier.deiss@gmail.com
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+************************************************************************************************
+
+    Fuzz harness of the help menu layout and of the parsers.
+
+    Random descriptions, with long words, $_n and $p( substitutions, tabs, newlines and
+    control bytes, are laid out at random widths. In each menu, no line is wider than the
+    terminal less the right margin, no byte but the newline is a control byte, the ANSI menu
+    is the plain menu plus its style codes, and each description without substitutions is
+    found once, whole, once the spaces are removed. Nothing may throw.
+
+    Random command lines, mutated schema files and mutated snapshots are then given to
+    parse_params, load_schema and attach_snapshot. They may be refused with an exception of
+    the library, never with an exception of the standard library like std::out_of_range, and
+    the object stays usable: a refused schema defines nothing and a refused snapshot changes
+    nothing.
+
+    Last, texts, command lines, schemas and snapshots of growing sizes are timed. The time
+    per byte of each size is compared with the one of the smallest size, a ratio above 4 is
+    reported as super-linear.
+
+    usage: fuzz_layout [iterations, 2000 by default] [seed, 1 by default]
+
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "Parameters.hpp"
+
+static int          failures = 0;
+static std::mt19937 rng;
+
+static void fail(const std::string& what) {
+    if(failures++<10) std::cerr << "FAILED: " << what << std::endl;
+}
+
+/* random int in [0, n) */
+static int pick(const int n) {
+    return std::uniform_int_distribution<int>(0, n-1)(rng);
+}
+
+/* the text with its control bytes escaped, cut to be printed in a message */
+static const std::string shown(const std::string& text) {
+    std::string out;
+    for(std::size_t j=0 ; j<text.size() && j<200 ; j++) {
+        const unsigned char c = static_cast<unsigned char>(text[j]);
+        if(c<' ' || c>=127) { char hex[8]; std::snprintf(hex, sizeof(hex), "\\x%02x", c); out += hex; }
+        else                out += text[j];
+    }
+    if(text.size()>200) out += "...";
+    return out;
+}
+
+/* runs f, false if it threw an exception of the library. They all derive from std::exception
+   directly, so a logic_error, a runtime_error or a bad_alloc is a bug in the library */
+static bool accepted(const std::function<void()>& f, const std::string& what) {
+    try                                { f(); return true; }
+    catch(const std::logic_error& e)   { fail(what + " threw logic_error: " + e.what()); }
+    catch(const std::runtime_error& e) { fail(what + " threw runtime_error: " + e.what()); }
+    catch(const std::bad_alloc&)       { fail(what + " threw bad_alloc"); }
+    catch(const std::exception&)       { }
+    catch(...)                         { fail(what + " threw a non-standard exception"); }
+    return false;
+}
+
+static const Parameters::config p_c {40, 400, 3, 1, 27, 5, 3, 2, Parameters::lang_us};
+static const Parameters::config p_c_fr {40, 400, 3, 1, 27, 5, 3, 2, Parameters::lang_fr};
+static char                     prog[] = "fuzz";
+static char*                    args[] = {prog};
+
+/*** help menu layout ***/
+
+static const std::string plain_word() {
+    std::string w;
+    const int n = pick(20)==0 ? 30 + pick(400) : 1 + pick(12);
+    for(int i=0 ; i<n ; i++) w += static_cast<char>('a' + pick(26));
+    if(pick(8)==0) w += pick(2)==0 ? "." : ",";
+    return w;
+}
+
+/* words, substitutions and control bytes */
+static const std::string noisy_word() {
+    static const char controls[] = {'\x01', '\x02', '\x03', '\x04', '\x1b', '\x7f', '\r', '\v'};
+    switch(pick(12)) {
+        case 0:  return "$_" + std::to_string(pick(5));
+        case 1:  return "$_";
+        case 2:  return "$_1" + std::string(pick(3), ',');
+        case 3:  return "$p(" + std::string(1 + pick(30), 'q') + (pick(2)==0 ? ")" : "") + (pick(2)==0 ? "." : "");
+        case 4:  return "\n";
+        case 5:  return "\t";
+        case 6:  return plain_word() + controls[pick(sizeof(controls))] + plain_word();
+        default: return plain_word();
+    }
+}
+
+static const std::string random_text(const bool plain) {
+    std::string text;
+    const int   n = pick(60);
+    for(int i=0 ; i<n ; i++) {
+        if(i!=0) text += pick(8)==0 ? "  " : " ";
+        text += plain ? plain_word() : noisy_word();
+    }
+    return text;
+}
+
+/* the text without its spaces, tabs and newlines */
+static const std::string compact(const std::string& text) {
+    std::string out;
+    for(const char c: text) if(c!=' ' && c!='\t' && c!='\n') out += c;
+    return out;
+}
+
+/* the ANSI menu without its style codes */
+static const std::string without_styles(const std::string& menu) {
+    std::string out;
+    for(std::size_t j=0 ; j<menu.size() ; j++) {
+        if(menu[j]=='\x1b' && j+3<menu.size() && menu[j+1]=='[' && menu[j+3]=='m') { j += 3; continue; }
+        out += menu[j];
+    }
+    return out;
+}
+
+/* checks the width and the bytes of each line of the menu, the bytes after the first of an
+   UTF-8 char take no room */
+static void check_menu(const std::string& menu, const int room, const std::string& what) {
+    std::size_t start = 0;
+    for(std::size_t end ; (end=menu.find('\n', start))!=std::string::npos ; start=end+1) {
+        int len = 0;
+        for(std::size_t j=start ; j<end ; j++) if((static_cast<unsigned char>(menu[j]) & 0xC0)!=0x80) len++;
+        if(len>room) {
+            fail(what + ": line of " + std::to_string(len) + " chars for " + std::to_string(room) + ": " + shown(menu.substr(start, end-start)));
+            return;
+        }
+    }
+    if(start!=menu.size()) fail(what + ": no newline after the last line");
+    for(const char c: menu) {
+        if((c>=0 && c<' ' && c!='\n') || c==127) { fail(what + ": control byte in the menu: " + shown(menu)); return; }
+    }
+}
+
+static void layout(const int iterations) {
+    for(int it=0 ; it<iterations ; it++) {
+        const int width = 40 + pick(161);
+        const std::string what = "layout " + std::to_string(it) + " at width " + std::to_string(width);
+        Parameters p(1, args, pick(4)==0 ? p_c_fr : p_c, width);
+        std::vector<std::string> plain;
+        p.set_program_description(random_text(false));
+        const int nb_params = 1 + pick(5);
+        for(int k=0 ; k<nb_params ; k++) {
+            /* the tag makes each plain description unique in the menu */
+            const std::string name = "p" + std::to_string(k);
+            const bool        is_plain = pick(2)==0;
+            const std::string desc = is_plain ? "#" + std::to_string(k) + "# " + random_text(true) : random_text(false);
+            if(is_plain) plain.push_back(desc);
+            switch(pick(3)) {
+                case 0:
+                    p.define_num_str_param<int>(name, {"value", "other"}, {1, 2}, desc, pick(2)==0);
+                    if(pick(2)==0) p.set_range<int>(name, -pick(100000), pick(100000));
+                    break;
+                case 1:  p.define_choice_param(name, "mode", "fast", {{"fast", random_text(false)}, {"slow", random_text(false)}}, desc, pick(2)==0); break;
+                default: p.define_param(name, desc);
+            }
+            if(k!=0 && pick(3)==0) p.add_conflicts(name, {"p0"});
+        }
+        if(nb_params>2 && pick(3)==0) p.add_at_most_group(1, {"p0", "p1", "p2"});
+        if(pick(2)==0) p.define_subcommand("run", random_text(false), [] (Parameters&) {});
+        std::string menu, styled;
+        const bool printed = accepted([&p, &menu, &styled] () {
+            Parameters::PlainRenderer plain_r(menu);
+            p.print_help(plain_r, false, true);
+            Parameters::AnsiRenderer ansi_r(styled);
+            p.print_help(ansi_r, false, true);
+        }, what);
+        if(!printed) { fail(what + ": print_help threw"); continue; }
+        check_menu(menu, width - p_c.right_margin_len, what);
+        if(without_styles(styled)!=menu) fail(what + ": the ANSI menu has other escape codes than its styles");
+        const std::string all = compact(menu);
+        for(const std::string& desc: plain) {
+            const std::size_t found = all.find(compact(desc));
+            if(found==std::string::npos)                              fail(what + ": text lost from " + shown(desc));
+            else if(all.find(compact(desc), found + 1)!=std::string::npos) fail(what + ": text duplicated from " + shown(desc));
+        }
+    }
+}
+
+/*** parsers ***/
+
+/* defines one parameter of each kind */
+static void define_all(Parameters& p) {
+    p.define_num_str_param<int>("n", {"first", "second"}, {0, 0}, "Two integers.");
+    p.define_num_str_param<double>("ratio", {"value"}, {0.5}, "A decimal.");
+    p.define_num_str_param<std::string>("name", {"text"}, {"none"}, "A string.");
+    p.define_choice_param("mode", "mode", "fast", {{"fast", "Fast."}, {"slow", "Slow."}}, "A choice.");
+    p.define_unit_param<long>("size", {"bytes"}, Parameters::unit_bytes, {0}, "A size.");
+    p.define_param("flag", "A flag.");
+    p.define_positional<int>("rest", "value", 0, Parameters::unbounded, "Positional values.");
+    p.set_occurrence_policy("name", Parameters::occurrence_accumulate);
+    p.set_range<int>("n", -100, 100);
+}
+
+static const std::string random_token() {
+    static const char* const tokens[] = {"--n", "--ratio", "--name", "--mode", "--size", "--flag", "--", "--nope", "-",
+                                         "fast", "slow", "1", "-5", "2.5", "1e999", "99999999999", "4KiB", "3parsecs",
+                                         "x", "'", "\"", "\\", "'a b'", "\"c\\\"d\"", "=", "$_1", ""};
+    if(pick(6)!=0) return tokens[pick(sizeof(tokens)/sizeof(tokens[0]))];
+    std::string t;
+    const int   n = 1 + pick(6);
+    for(int i=0 ; i<n ; i++) t += static_cast<char>(pick(256));
+    return t;
+}
+
+static void command_lines(const int iterations) {
+    Parameters p(1, args, p_c);
+    define_all(p);
+    p.parse_params("--n 1 2 --name a --name b 7");
+    const std::string good = p.snapshot();
+    for(int it=0 ; it<iterations ; it++) {
+        std::string command;
+        const int   n = pick(12);
+        for(int i=0 ; i<n ; i++) command += (i!=0 ? " " : "") + random_token();
+        accepted([&p, &command] () { p.parse_params(command); }, "parse_params(" + shown(command) + ")");
+        const bool again = accepted([&p] () { p.parse_params("--n 1 2 --name a --name b 7"); }, "parse_params after " + shown(command));
+        if(!again || p.snapshot()!=good) fail("values after parse_params(" + shown(command) + ")");
+    }
+}
+
+static const std::string schema_text =
+    "help80-schema 1\n"
+    "subsection\tOUTPUT\n"
+    "value\twidth\tint\tvalue|other\t80|2\t1\tWidth of the $_1 output.\n"
+    "value\tratio\tdouble\tvalue\t0.5\t\tA ratio.\\nOn two lines.\n"
+    "choice\tformat\tformat\ttext\ttext=Plain text.|json=JSON.\t1\tOutput $p(format).\n"
+    "param\tverbose\tPrints more.\n"
+    "# comment\n"
+    "\n"
+    "param\tquiet\tPrints less.\r\n";
+
+/* flips, removes or repeats bytes and lines */
+static const std::string mutated(std::string text) {
+    static const char bytes[] = {'\t', '\n', '\r', '|', '=', '\\', '#', '0', '9', '-', 'x', ' ', '\0'};
+    const int nb = 1 + pick(4);
+    for(int m=0 ; m<nb && !text.empty() ; m++) {
+        const std::size_t at = static_cast<std::size_t>(pick(static_cast<int>(text.size())));
+        switch(pick(5)) {
+            case 0:  text[at] = bytes[pick(sizeof(bytes))]; break;
+            case 1:  text[at] = static_cast<char>(pick(256)); break;
+            case 2:  text.erase(at, 1 + pick(8)); break;
+            case 3:  text.resize(at); break;
+            default: {
+                const std::size_t start = text.rfind('\n', at);
+                const std::size_t end   = text.find('\n', at);
+                const std::size_t from  = start==std::string::npos ? 0 : start + 1;
+                text.insert(from, text.substr(from, end==std::string::npos ? std::string::npos : end - from + 1));
+            }
+        }
+    }
+    return text;
+}
+
+static void schemas(const int iterations) {
+    const std::string path = "fuzz_layout.schema";
+    std::string empty_menu;
+    {
+        Parameters empty(1, args, p_c, 80);
+        Parameters::PlainRenderer r(empty_menu);
+        empty.print_help(r, false, false);
+    }
+    for(int it=0 ; it<iterations ; it++) {
+        const std::string text = mutated(schema_text);
+        { std::ofstream out(path, std::ios::binary); out << text; }
+        const std::string what = "load_schema(" + shown(text) + ")";
+        Parameters p(1, args, p_c, 80);
+        const bool loaded = accepted([&p, &path] () { p.load_schema(path); }, what);
+        std::string menu;
+        if(!accepted([&p, &menu] () { Parameters::PlainRenderer r(menu); p.print_help(r, false, false); }, what + ", print_help")) {
+            fail(what + ": print_help threw");
+            continue;
+        }
+        if(loaded) check_menu(menu, 80 - p_c.right_margin_len, what);
+        else if(menu!=empty_menu) fail(what + ": a refused schema defined entries");
+    }
+    std::remove(path.c_str());
+}
+
+static void snapshots(const int iterations) {
+    Parameters p(1, args, p_c);
+    define_all(p);
+    p.parse_params("--n 1 2 --ratio 0.25 --name a --name bc --mode slow --size 4KiB --flag 7 8");
+    const std::string blob = p.snapshot();
+    for(int it=0 ; it<iterations ; it++) {
+        std::string bad = blob;
+        if(pick(4)==0) bad += std::string(1 + pick(16), static_cast<char>(pick(256)));
+        else           bad = mutated(bad);
+        p.parse_params("--n 3 4");
+        const std::string before = p.snapshot();
+        const std::string what   = "attach_snapshot(" + shown(bad) + ")";
+        if(!accepted([&p, &bad] () { p.attach_snapshot(bad.data(), bad.size()); }, what)) {
+            if(p.snapshot()!=before) fail(what + ": a refused snapshot changed the values");
+            continue;
+        }
+        /* what was accepted is a snapshot of these params */
+        const std::string after = p.snapshot();
+        if(!accepted([&p, &after] () { p.attach_snapshot(after.data(), after.size()); }, what + ", again") || p.snapshot()!=after) {
+            fail(what + ": the snapshot of the attached values cannot be attached");
+        }
+    }
+}
+
+/*** growth ***/
+
+/* seconds taken by f, best of 3 runs */
+static double best_time(const std::function<void()>& f) {
+    double best = 1e9;
+    for(int run=0 ; run<3 ; run++) {
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        f();
+        best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+    return best;
+}
+
+/* times make(n) then run(input) for growing n, compares the time per byte with the smallest n */
+static void growth(const std::string& what, const std::function<std::string(const std::size_t)>& make, const std::function<void(const std::string&)>& run) {
+    double base = 0;
+    std::cout << "growth: " << what;
+    for(std::size_t n=1<<14 ; n<=(1<<20) ; n*=4) {
+        const std::string input = make(n);
+        bool              ok    = true;
+        const double      t     = best_time([&run, &input, &ok, &what] () { ok = accepted([&run, &input] () { run(input); }, what) && ok; });
+        if(!ok) { fail(what + " refused its input of " + std::to_string(n) + " bytes"); break; }
+        const double per_byte = t/input.size();
+        if(base==0) base = per_byte;
+        const double ratio = per_byte/base;
+        std::cout << ", " << (n>>10) << "k " << static_cast<int>(ratio*100)/100. << "x";
+        if(ratio>4) fail(what + " is super-linear: " + std::to_string(ratio) + " times slower per byte at " + std::to_string(n) + " bytes");
+    }
+    std::cout << std::endl;
+}
+
+/* lays out a description */
+static void print_desc(const std::string& desc) {
+    Parameters p(1, args, p_c, 80);
+    p.define_num_str_param<int>("n", {"value"}, {1}, desc);
+    std::string menu;
+    Parameters::PlainRenderer r(menu);
+    p.print_help(r, false, false);
+}
+
+static void growths() {
+    growth("words", [] (const std::size_t n) {
+        std::string text;
+        while(text.size()<n) text += plain_word() + " ";
+        return text;
+    }, print_desc);
+    growth("one word", [] (const std::size_t n) { return std::string(n, 'w'); }, print_desc);
+    growth("substitutions", [] (const std::size_t n) {
+        std::string text;
+        while(text.size()<n) text += "$_1 $p(n). $_0, ";
+        return text;
+    }, print_desc);
+    growth("newlines", [] (const std::size_t n) { return std::string(n, '\n'); }, print_desc);
+    growth("parse_params", [] (const std::size_t n) {
+        std::string command;
+        for(int k=0 ; command.size()<n ; k++) command += "--name 'a b' " + std::to_string(k) + " ";
+        return command;
+    }, [] (const std::string& command) {
+        Parameters p(1, args, p_c);
+        define_all(p);
+        p.parse_params(command);
+    });
+    growth("load_schema", [] (const std::size_t n) {
+        std::string text = "help80-schema 1\n";
+        for(int k=0 ; text.size()<n ; k++) text += "value\tv" + std::to_string(k) + "\tint\tvalue\t1\t1\tValue $_1.\n";
+        return text;
+    }, [] (const std::string& text) {
+        const std::string path = "fuzz_layout.schema";
+        { std::ofstream out(path, std::ios::binary); out << text; }
+        Parameters p(1, args, p_c);
+        p.load_schema(path);
+        std::remove(path.c_str());
+    });
+    growth("attach_snapshot", [] (const std::size_t n) {
+        std::string command;
+        for(int k=0 ; command.size()<n/2 ; k++) command += std::to_string(k) + " ";
+        Parameters p(1, args, p_c);
+        define_all(p);
+        p.parse_params(command);
+        return p.snapshot();
+    }, [] (const std::string& blob) {
+        Parameters p(1, args, p_c);
+        define_all(p);
+        p.attach_snapshot(blob.data(), blob.size());
+    });
+}
+
+int main(int argc, char** argv) {
+    const int      iterations = argc>1 ? std::atoi(argv[1]) : 2000;
+    const unsigned seed       = argc>2 ? static_cast<unsigned>(std::atoi(argv[2])) : 1;
+    rng.seed(seed);
+
+    layout(iterations);
+    command_lines(iterations);
+    schemas(iterations/4);
+    snapshots(iterations);
+    std::cout << "fuzz: " << iterations << " menus, " << iterations << " command lines, " << iterations/4 << " schemas and "
+              << iterations << " snapshots, seed " << seed << std::endl;
+    growths();
+
+    if(failures!=0) {
+        std::cerr << failures << " failures" << std::endl;
+        return 1;
+    }
+    std::cout << "ok" << std::endl;
+    return 0;
+}
@@ -51,6 +51,7 @@ int main(int argc, char** argv) {
                               "You can also define multiple choices parameters. You need to give the multiple choices in an array of pairs (choice, choice_description):", true);
         p.define_param("simple_parameter", "Parameter $_0 doesn't expect any value.");
         p.define_num_str_param<std::string>("string_path", {"folder"}, {"./"}, "This parameter expects a std::string.", true);
+        p.define_unit_param<unsigned long long int>("cache_size", {"size"}, Parameters::unit_bytes, {4ull << 30}, "Sizes, durations and counts can be typed with a unit, like 512MiB, 250ms or 10k. The value is stored in the base unit, here in bytes, and the default value is printed in the largest unit that divides it.", true);
         
         /* new subsection */
         p.insert_subsection("SECOND SUBSECTION");
@@ -70,6 +71,17 @@ int main(int argc, char** argv) {
         std::cerr << "error while defining arguments: " << e.what() << std::endl;
     }
     
+    /* answer shell completion queries */
+    if(p.complete()) return 0;
+    
+    /* search the help menu, like "--help choice mode" */
+    if(argc>2 && std::string(argv[1])=="--help") {
+        std::string query = argv[2];
+        for(int i=3 ; i<argc ; i++) query += std::string(" ") + argv[i];
+        p.search_help(query);
+        return 0;
+    }
+    
     /* parse p from command line */
     try {
         p.parse_params();
@@ -97,6 +109,7 @@ int main(int argc, char** argv) {
         std::cout << "   multiple_choice:  \"" << p.cho_val("multiple_choice") << "\"" << std::endl;
         std::cout << "   simple_parameter: " << p.is_spec("simple_parameter") << std::endl;
         std::cout << "   string_path:      " << p.str_val("string_path") << std::endl;
+        std::cout << "   cache_size:       " << p.num_val<unsigned long long int>("cache_size") << std::endl;
         std::cout << std::endl;
         
         std::cout << "SECOND SUBSECTION:" << std::endl;
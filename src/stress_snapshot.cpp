@@ -0,0 +1,199 @@
+/*
+
+************************************************************************************************
+
+LICENSE
+
+    Help80 - Copyright (C) 2016 - Olivier Deiss - olivier.deiss@gmail.com
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+************************************************************************************************
+
+    Stress test of the published snapshots, and benchmark of the reads.
+
+    A thread reparses "--a k --b 2k --name vk" with k going up, and sometimes arguments that
+    fail to parse. Another one publishes the current values again. Readers check that each
+    snapshot they pin is whole (b is 2a and name is "va"), that a never goes down, and that
+    the values of a failed reparse are never seen. More threads than slots in the reader
+    table then take guards in turn, nested or not. Last, the reads per second are measured
+    with 1, 2, 4... threads up to the nb of cores.
+
+    usage: stress_snapshot [seconds of stress, 2 by default]
+
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Parameters.hpp"
+
+static std::atomic<long> failures(0);
+
+static void fail(const std::string& what) {
+    if(failures++<10) std::cerr << "FAILED: " << what << std::endl;
+}
+
+/* parses "--a k --b 2k --name vk" */
+static void reparse(Parameters& p, const int k) {
+    const std::string a = std::to_string(k), b = std::to_string(2*k), name = "v" + a;
+    char const* const argv[] = {"stress", "--a", a.c_str(), "--b", b.c_str(), "--name", name.c_str()};
+    p.reparse(7, argv);
+}
+
+/* checks a pinned snapshot, returns its value of a */
+static int check(const Parameters::Snapshot& s, const int last_a) {
+    const int a = s.num_val<int>("a");
+    if(s.num_val<int>("b")!=2*a)                    fail("torn snapshot, a=" + std::to_string(a));
+    if(s.str_val("name")!="v" + std::to_string(a)) fail("torn name, a=" + std::to_string(a));
+    if(a<0)                                         fail("values of a failed reparse are visible");
+    if(a<last_a)                                    fail("a went down from " + std::to_string(last_a) + " to " + std::to_string(a));
+    return a;
+}
+
+static void stress(Parameters& p, const double seconds) {
+    const std::chrono::steady_clock::time_point stop = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(seconds));
+    std::atomic<bool> done(false);
+    std::atomic<long> reads(0);
+    long              writes = 0;
+    /* readers */
+    std::vector<std::thread> threads;
+    const unsigned nb_readers = std::max(2u, std::thread::hardware_concurrency());
+    for(unsigned t=0 ; t<nb_readers ; t++) {
+        threads.emplace_back([&p, &done, &reads, t] () {
+            int  last_a = 0;
+            long n      = 0;
+            while(!done.load()) {
+                Parameters::ReadGuard guard(p);
+                last_a = check(*guard, last_a);
+                if(t%2==1) {
+                    /* a nested guard may pin a newer snapshot, never an older one */
+                    Parameters::ReadGuard nested(p);
+                    last_a = check(*nested, last_a);
+                }
+                n++;
+            }
+            reads += n;
+        });
+    }
+    /* publisher of the current values, they must be the last parsed ones */
+    threads.emplace_back([&p, &done] () {
+        while(!done.load()) { p.publish(); std::this_thread::yield(); }
+    });
+    /* writer */
+    for(int k=1 ; std::chrono::steady_clock::now()<stop ; k++) {
+        reparse(p, k);
+        writes++;
+        if(k%16==0) {
+            char const* const argv[] = {"stress", "--a", "-1", "--b", "x"};
+            bool thrown = false;
+            try { p.reparse(5, argv); } catch(const std::exception&) { thrown = true; }
+            if(!thrown) fail("a reparse of invalid arguments was accepted");
+        }
+    }
+    done = true;
+    for(std::thread& th: threads) th.join();
+    std::cout << "stress: " << writes << " reparses, " << reads.load() << " reads by " << nb_readers << " threads" << std::endl;
+}
+
+/* more threads than slots are alive at once, each takes guards in turn and stays alive */
+static void many_threads(Parameters& p) {
+    const std::size_t        nb_threads = 3*256;
+    std::atomic<std::size_t> started(0);
+    std::atomic<std::size_t> finished(0);
+    std::atomic<bool>        go(false);
+    std::atomic<bool>        release(false);
+    std::vector<std::thread> threads;
+    for(std::size_t t=0 ; t<nb_threads ; t++) {
+        threads.emplace_back([&p, &started, &finished, &go, &release] () {
+            started++;
+            while(!go.load()) std::this_thread::yield();
+            for(int j=0 ; j<20 ; j++) {
+                Parameters::ReadGuard guard(p);
+                Parameters::ReadGuard nested(p);
+                check(*nested, 0);
+            }
+            finished++;
+            while(!release.load()) std::this_thread::yield();
+        });
+    }
+    while(started.load()!=nb_threads) std::this_thread::yield();
+    go = true;
+    for(int k=1 ; k<=50 ; k++) reparse(p, 1000000+k);
+    /* a slot kept by a thread after its guards would block the others until it exits */
+    const std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::seconds(20);
+    while(finished.load()!=nb_threads && std::chrono::steady_clock::now()<deadline) std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    if(finished.load()!=nb_threads) fail(std::to_string(nb_threads-finished.load()) + " threads could not take a guard");
+    release = true;
+    for(std::thread& th: threads) th.join();
+    std::cout << "threads: " << finished.load() << " of " << nb_threads << " live threads took guards" << std::endl;
+}
+
+/* reads per second, with 1, 2, 4... threads */
+static void benchmark(Parameters& p) {
+    const unsigned nb_cores = std::max(1u, std::thread::hardware_concurrency());
+    for(unsigned nb_threads=1 ; ; nb_threads*=2) {
+        if(nb_threads>nb_cores) nb_threads = nb_cores;
+        std::atomic<bool>        done(false);
+        std::atomic<long>        reads(0);
+        std::vector<std::thread> threads;
+        for(unsigned t=0 ; t<nb_threads ; t++) {
+            threads.emplace_back([&p, &done, &reads] () {
+                long n   = 0;
+                long sum = 0;
+                while(!done.load(std::memory_order_relaxed)) {
+                    Parameters::ReadGuard guard(p);
+                    sum += guard->num_val<int>("a");
+                    n++;
+                }
+                reads += n + (sum==-1 ? 1 : 0);
+            });
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(300));
+        done = true;
+        for(std::thread& th: threads) th.join();
+        const double per_second = reads.load()/0.3;
+        std::cout << "bench: " << nb_threads << " thread(s), " << static_cast<long>(per_second) << " reads/s, "
+                  << static_cast<long>(per_second/nb_threads) << " per thread" << std::endl;
+        if(nb_threads==nb_cores) break;
+    }
+}
+
+int main(int argc, char** argv) {
+    const double seconds = argc>1 ? std::atof(argv[1]) : 2;
+
+    Parameters::config p_c {40, 80, 3, 1, 27, 5, 3, 2, Parameters::lang_us};
+    Parameters p(argc, argv, p_c);
+    p.define_num_str_param<int>("a", {"value"}, {0}, "Counter.");
+    p.define_num_str_param<int>("b", {"value"}, {0}, "Twice the counter.");
+    p.define_num_str_param<std::string>("name", {"text"}, {"v0"}, "Name of the counter.");
+    p.publish();
+
+    stress(p, seconds);
+    many_threads(p);
+    benchmark(p);
+
+    if(failures.load()!=0) {
+        std::cerr << failures.load() << " failures" << std::endl;
+        return 1;
+    }
+    std::cout << "ok" << std::endl;
+    return 0;
+}